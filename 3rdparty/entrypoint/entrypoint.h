@@ -265,6 +265,20 @@ struct entrypoint_ctx_t
 		#ifdef ENTRYPOINT_PROVIDE_TIME
 			struct timeval prev_time;
 		#endif
+	#elif defined(__linux__)
+		ep_size_t size; // virtual screen
+		uint32_t frames; // how many frames to run, 0 is unlimited
+		uint32_t frame; // current frame index
+		union
+		{
+			uint8_t flags;
+			struct
+			{
+				#ifdef ENTRYPOINT_PROVIDE_TIME
+				uint8_t flag_time_set: 1;
+				#endif
+			};
+		};
 	#endif
 
 	// -------------------------------------------------------------------------
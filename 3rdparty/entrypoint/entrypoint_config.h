@@ -85,3 +85,12 @@
 #define ENTRYPOINT_ANDROID_LOG_TAG "EntryPoint"
 
 // -----------------------------------------------------------------------------
+// Linux, headless only
+
+#define ENTRYPOINT_LINUX_PREPARE_PARAMS {}
+#define ENTRYPOINT_LINUX_WIDTH		1024
+#define ENTRYPOINT_LINUX_HEIGHT		768
+#define ENTRYPOINT_LINUX_FRAMES		600 // 0 runs until entrypoint_loop returns != 0
+#define ENTRYPOINT_LINUX_DT			(1.0 / 60.0) // fake clock step in seconds
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,136 @@
+// headless only, there is no window on linux:
+// - ep_delta_time is a fixed clock so runs are reproducible
+// - loop runs for --frames N (or ENTRYPOINT_LINUX_FRAMES), 0 runs until entrypoint_loop asks to stop
+// - --size WxH overrides ENTRYPOINT_LINUX_WIDTH/HEIGHT
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#define ENTRYPOINT_CTX
+#include "entrypoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+static entrypoint_ctx_t ctx = {0};
+entrypoint_ctx_t * ep_ctx() {return &ctx;}
+
+// -----------------------------------------------------------------------------
+
+ep_size_t ep_size()
+{
+	return ctx.size;
+}
+
+bool ep_retina()
+{
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+static void _args()
+{
+	for(int i = 1; i + 1 < ctx.argc; ++i)
+	{
+		if(!strcmp(ctx.argv[i], "--frames"))
+			ctx.frames = (uint32_t)strtoul(ctx.argv[++i], NULL, 10);
+		else if(!strcmp(ctx.argv[i], "--size"))
+		{
+			unsigned w = 0, h = 0;
+			if(sscanf(ctx.argv[++i], "%ux%u", &w, &h) == 2 && w && h && w <= UINT16_MAX && h <= UINT16_MAX)
+			{
+				ctx.size.w = (uint16_t)w;
+				ctx.size.h = (uint16_t)h;
+			}
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	ctx.argc = argc;
+	ctx.argv = argv;
+	ctx.size.w = ENTRYPOINT_LINUX_WIDTH;
+	ctx.size.h = ENTRYPOINT_LINUX_HEIGHT;
+	ctx.frames = ENTRYPOINT_LINUX_FRAMES;
+
+	ENTRYPOINT_LINUX_PREPARE_PARAMS;
+
+	_args();
+
+	int32_t result_code = 0;
+	if((result_code = entrypoint_init(ctx.argc, ctx.argv)) != 0)
+		return result_code;
+
+	for(ctx.frame = 0; !ctx.frames || ctx.frame < ctx.frames; ++ctx.frame)
+		if(entrypoint_loop() != 0)
+			break;
+
+	entrypoint_might_unload();
+	return entrypoint_deinit();
+}
+
+// -----------------------------------------------------------------------------
+
+#ifdef ENTRYPOINT_PROVIDE_TIME
+
+double ep_delta_time()
+{
+	// first call is 0 like on other platforms, then every frame takes exactly the same time
+	if(!ctx.flag_time_set)
+	{
+		ctx.flag_time_set = true;
+		return 0.0;
+	}
+	return ENTRYPOINT_LINUX_DT;
+}
+
+void ep_sleep(double seconds)
+{
+	struct timespec t;
+	t.tv_sec = (time_t)seconds;
+	t.tv_nsec = (long)((seconds - (double)t.tv_sec) * 1000000000.0);
+	nanosleep(&t, NULL);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+#ifdef ENTRYPOINT_PROVIDE_LOG
+
+void ep_log(const char * message, ...)
+{
+	va_list args;
+	va_start(args, message);
+	vprintf(message, args);
+	fflush(stdout);
+	va_end(args);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+#ifdef ENTRYPOINT_PROVIDE_INPUT
+
+// no input devices, everything stays released
+
+void ep_touch(ep_touch_t * touch)
+{
+	if(touch)
+		memset(touch, 0, sizeof(ep_touch_t));
+}
+
+bool ep_khit(int32_t key) {return false;}
+bool ep_kdown(int32_t key) {return false;}
+uint32_t ep_kchar() {return 0;}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,474 @@
+// microbenchmarks of engine hot paths, built as leengine_bench in headless linux build
+// everything runs in game_init with the noop renderer, so cases measure cpu side only
+//
+// usage: leengine_bench [--filter substring] [--time seconds] [--font file.ttf] [--out file]
+// output is one json object per line, e.g.
+// {"name":"tr_model_spr","n":4194304,"ns_op":21.37,"bytes_op":0.0,"allocs_op":0.000}
+// - ns_op is wall time per op, frame turnover of drawing cases (flush, bgfx_frame) isn't timed
+// - bytes_op and allocs_op count malloc/calloc/realloc calls of engine, 3rdparty and bgfx code on
+//   this thread, linked with --wrap so allocations inside libc itself (e.g. fopen) are not seen
+// - cases which can't run print {"name":...,"skipped":"reason"}
+
+#include "window.h"
+#include "render.h"
+#include "render_batch.h"
+#include "render_9slice.h"
+#include "render_text.h"
+#include "render_soft.h"
+#include "scene.h"
+#include "filesystem.h"
+#include "dict.h"
+#include "portable.h"
+#include <tinycthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef BENCH_MIN_TIME
+#define BENCH_MIN_TIME (0.25) // seconds per case
+#endif
+#define BENCH_MAX_N (1 << 26)
+#define BENCH_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+#define BENCH_YAML "bench_tmp.yaml"
+#define BENCH_PNG "bench_tmp.png"
+#define BENCH_PNG_SIZE 256
+#define BENCH_YAML_ITEMS 256
+#define BENCH_SCENE_GROUPS 64
+#define BENCH_SCENE_PER_GROUP 16
+#define BENCH_TEXTS 64
+
+typedef struct
+{
+	const char * name;
+	const char * (*setup)(); // returns reason to skip or NULL, shared setups only do their work once
+	void (*op)(uint32_t i);
+	void (*teardown)();
+	uint32_t ops_per_frame; // drawing cases get a new frame after this many ops, 0 if case doesn't draw
+} bench_case_t;
+
+static struct
+{
+	const char * filter;
+	const char * font_file;
+	double min_time;
+	FILE * out;
+
+	uint64_t bytes;
+	uint64_t allocs;
+
+	bool tex_ready;
+	tex_t tex[2];
+	bool font_ready;
+	font_t font;
+	vrtx_t quads[256 * 4];
+	char texts[BENCH_TEXTS][64];
+	scene_t * scene;
+	scene_entity_t * entities;
+	char (*names)[32];
+	char prefixes[BENCH_SCENE_GROUPS][16];
+
+	volatile float sink; // keeps results of pure functions alive
+} ctx;
+
+// only the thread running cases counts, bgfx render thread allocates on its own
+static _Thread_local bool counting = false;
+
+// -----------------------------------------------------------------------------
+// allocation counters
+
+#ifdef BENCH_COUNT_ALLOCS
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+
+static void _count(size_t size)
+{
+	if(!counting)
+		return;
+	ctx.bytes += size;
+	ctx.allocs++;
+}
+
+void * __wrap_malloc(size_t size) {_count(size); return __real_malloc(size);}
+void * __wrap_calloc(size_t count, size_t size) {_count(count * size); return __real_calloc(count, size);}
+void * __wrap_realloc(void * ptr, size_t size) {_count(size); return __real_realloc(ptr, size);}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// harness
+
+static void _frame()
+{
+	bool was_counting = counting;
+	counting = false;
+
+	r_frame_end();
+	_t_flush();
+	rs_frame();
+	bgfx_frame(false);
+	_r_stats_frame();
+	_t_cleanup();
+	r_viewport(0, 0, w_width(), w_height(), r_coloru(0, 0, 0, 255));
+	tr_set_world2d(tr2d_identity());
+
+	counting = was_counting;
+}
+
+static double _measure(const bench_case_t * c, uint32_t n)
+{
+	ctx.bytes = ctx.allocs = 0;
+	counting = true;
+
+	double total = 0.0, t = hp_time();
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		c->op(i);
+		if(c->ops_per_frame && (i + 1) % c->ops_per_frame == 0)
+		{
+			total += hp_time() - t;
+			_frame();
+			t = hp_time();
+		}
+	}
+	total += hp_time() - t;
+
+	counting = false;
+	if(c->ops_per_frame)
+		_frame();
+	return total;
+}
+
+static void _run(const bench_case_t * c)
+{
+	if(ctx.filter && !strstr(c->name, ctx.filter))
+		return;
+
+	const char * skip = c->setup ? c->setup() : NULL;
+	if(skip)
+	{
+		fprintf(ctx.out, "{\"name\":\"%s\",\"skipped\":\"%s\"}\n", c->name, skip);
+		fflush(ctx.out);
+		return;
+	}
+
+	// first round warms up caches, then grow n until a round takes long enough
+	_measure(c, 1);
+	uint32_t n = 1;
+	double t = 0.0;
+	while(true)
+	{
+		t = _measure(c, n);
+		if(t >= ctx.min_time || n >= BENCH_MAX_N)
+			break;
+		double k = t > 0.0 ? ctx.min_time / t * 1.2 : 100.0;
+		n = (uint32_t)gb_min((double)n * gb_clamp(k, 2.0, 100.0), (double)BENCH_MAX_N);
+	}
+
+	fprintf(ctx.out, "{\"name\":\"%s\",\"n\":%u,\"ns_op\":%.2f,\"bytes_op\":%.1f,\"allocs_op\":%.3f}\n",
+		c->name, n, t * 1000000000.0 / n, (double)ctx.bytes / n, (double)ctx.allocs / n);
+	fflush(ctx.out);
+
+	if(c->teardown)
+		c->teardown();
+}
+
+// -----------------------------------------------------------------------------
+// transforms
+
+static void _tr_model_spr(uint32_t i)
+{
+	trns_t m = tr_model_spr((float)(i & 255), 10.0f, (float)(i & 359), 0.5f, 0.5f, 1.0f, 1.0f, 0.5f, 0.5f, 64.0f, 32.0f, 0.0f, 0.0f);
+	ctx.sink += m.e[12];
+}
+
+static void _tr2d_model_spr(uint32_t i)
+{
+	trns2d_t m = tr2d_model_spr((float)(i & 255), 10.0f, (float)(i & 359), 0.5f, 0.5f, 1.0f, 1.0f, 0.5f, 0.5f, 64.0f, 32.0f, 0.0f, 0.0f);
+	ctx.sink += m.tx;
+}
+
+// -----------------------------------------------------------------------------
+// rendering
+
+static void _fill_quads()
+{
+	for(uint32_t q = 0; q < 256; ++q)
+	{
+		float x = (float)(q % 16) * 32.0f - 256.0f, y = (float)(q / 16) * 32.0f - 256.0f;
+		vrtx_t v[4] =
+		{
+			{x,         y + 32.0f, 0.0f, 0.0f, 0.0f, 0xffffffff},
+			{x + 32.0f, y + 32.0f, 0.0f, 1.0f, 0.0f, 0xffffffff},
+			{x + 32.0f, y,         0.0f, 1.0f, 1.0f, 0xffffffff},
+			{x,         y,         0.0f, 0.0f, 1.0f, 0xffffffff},
+		};
+		memcpy(ctx.quads + q * 4, v, sizeof(v));
+	}
+}
+
+// shared by drawing cases, done once
+static const char * _textures_setup()
+{
+	if(ctx.tex_ready)
+		return NULL;
+
+	// second texture is a real decoded image, so batches see texture switches
+	uint32_t * pixels = (uint32_t*)malloc(BENCH_PNG_SIZE * BENCH_PNG_SIZE * 4);
+	for(uint32_t i = 0; i < BENCH_PNG_SIZE * BENCH_PNG_SIZE; ++i)
+		pixels[i] = (i * 2654435761u) | 0xff000000;
+	bool ok = stbi_write_png_fs(BENCH_PNG, BENCH_PNG_SIZE, BENCH_PNG_SIZE, 4, pixels, BENCH_PNG_SIZE * 4) != 0;
+	free(pixels);
+	if(!ok)
+		return "can't write " BENCH_PNG;
+
+	ctx.tex[0] = r_white_tex();
+	ctx.tex[1] = r_load(BENCH_PNG, TEX_FLAGS_NO_ATLAS);
+	_fill_quads();
+	_frame();
+	ctx.tex_ready = true;
+	return NULL;
+}
+
+static void _r_render_transient(uint32_t i)
+{
+	static const uint16_t idx[6] = {0, 1, 2, 0, 2, 3};
+	vrtx_t v[4];
+	memcpy(v, ctx.quads + (i & 255) * 4, sizeof(v));
+	uint16_t ibuf[6];
+	memcpy(ibuf, idx, sizeof(ibuf));
+	tr_set_world2d(tr2d_model_spr(0.0f, 0.0f, (float)(i & 63), 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f));
+	r_render_transient(v, 4, ibuf, 6, ctx.tex[i & 1].tex, 1.0f, 1.0f, 1.0f, 0.5f, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+}
+
+// one op is 256 sprites alternating between two textures in runs of 16 and a flush
+static void _rb_add_flush(uint32_t i)
+{
+	for(uint32_t q = 0; q < 256; q += 16)
+		rb_add_quads(ctx.tex[(q / 16) & 1].tex, ctx.quads + q * 4, 16, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+	rb_flush();
+}
+
+// same sprites with rb_sorting, they don't overlap so each flush merges into one draw per texture
+static const char * _sorted_setup()
+{
+	const char * skip = _textures_setup();
+	if(!skip)
+		rb_sorting(true);
+	return skip;
+}
+
+static void _sorted_teardown()
+{
+	rb_sorting(false);
+}
+
+static void _r_9slice(uint32_t i)
+{
+	tex_9slice_t slice = {0.25f, 0.25f, 0.75f, 0.75f, 1.0f};
+	r_9slice(ctx.tex[1], slice, 200.0f, 120.0f, (float)(i & 255) - 128.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, false);
+}
+
+static void _textures_teardown()
+{
+	if(!ctx.tex_ready)
+		return;
+	r_free(ctx.tex[1]);
+	remove(BENCH_PNG);
+	ctx.tex_ready = false;
+}
+
+// -----------------------------------------------------------------------------
+// text
+
+static const char * _text_setup()
+{
+	if(ctx.font_ready)
+		return NULL;
+
+	ctx.font = t_add("bench", ctx.font_file);
+	if(ctx.font < 0)
+		return "no font, pass --font file.ttf";
+	for(uint32_t i = 0; i < BENCH_TEXTS; ++i)
+		snprintf(ctx.texts[i], sizeof(ctx.texts[i]), "Score %u, level %u of %u", i * 7919u, i, BENCH_TEXTS);
+	ctx.font_ready = true;
+	return NULL;
+}
+
+static void _r_text(uint32_t i, const char * text)
+{
+	r_text_ex2(ctx.font, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+		1.0f, 1.0f, 1.0f, 1.0f, false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+		NULL, TEXT_ALIGN_LEFT | TEXT_ALIGN_BASELINE, 24.0f, 0.0f, text);
+}
+
+static void _r_text_same(uint32_t i) {_r_text(i, ctx.texts[0]);}
+static void _r_text_varying(uint32_t i) {_r_text(i, ctx.texts[i % BENCH_TEXTS]);}
+
+// -----------------------------------------------------------------------------
+// yaml
+
+static const char * _dparsey_setup()
+{
+	#ifndef LIBYAML_AVAILABLE
+	return "built without LIBYAML_AVAILABLE";
+	#else
+	// roughly what slice tool exports for a scene
+	FILE * f = fsopen(BENCH_YAML, "w");
+	if(!f)
+		return "can't write " BENCH_YAML;
+	fprintf(f, "name: bench\nsize: [1024, 768]\nentities:\n");
+	for(uint32_t i = 0; i < BENCH_YAML_ITEMS; ++i)
+		fprintf(f, "  - name: group%02u/entity%04u\n    pos: [%u, %u]\n    size: [64, 32]\n    texture: res/atlas_%u.png\n    visible: %s\n",
+			i / BENCH_SCENE_PER_GROUP, i, i * 13 % 1024, i * 29 % 768, i % 4, i % 3 ? "true" : "false");
+	fclose(f);
+	return NULL;
+	#endif
+}
+
+static void _dparsey(uint32_t i)
+{
+	#ifdef LIBYAML_AVAILABLE
+	dfree(dparsey(BENCH_YAML));
+	#endif
+}
+
+static void _dparsey_teardown()
+{
+	remove(BENCH_YAML);
+}
+
+// -----------------------------------------------------------------------------
+// scene
+
+static const char * _scene_setup()
+{
+	size_t count = BENCH_SCENE_GROUPS * BENCH_SCENE_PER_GROUP;
+	ctx.scene = (scene_t*)calloc(1, sizeof(scene_t));
+	ctx.entities = (scene_entity_t*)calloc(count, sizeof(scene_entity_t));
+	ctx.names = calloc(count, sizeof(ctx.names[0]));
+	ctx.scene->entities = (scene_entity_t**)calloc(count, sizeof(scene_entity_t*));
+	ctx.scene->entities_count = count;
+	for(size_t i = 0; i < count; ++i)
+	{
+		snprintf(ctx.names[i], sizeof(ctx.names[i]), "group%02u/entity%04u", (uint32_t)(i / BENCH_SCENE_PER_GROUP), (uint32_t)i);
+		ctx.entities[i].name = ctx.names[i];
+		ctx.scene->entities[i] = ctx.entities + i;
+	}
+	for(uint32_t i = 0; i < BENCH_SCENE_GROUPS; ++i)
+		snprintf(ctx.prefixes[i], sizeof(ctx.prefixes[i]), "group%02u/", i);
+	return NULL;
+}
+
+static void _scene_get_entities_for_prefix(uint32_t i)
+{
+	scene_entities_list_t l = scene_get_entities_for_prefix(ctx.scene, ctx.prefixes[i % BENCH_SCENE_GROUPS]);
+	ctx.sink += (float)l.count;
+}
+
+static void _scene_teardown()
+{
+	free(ctx.scene->entities);
+	free(ctx.scene);
+	free(ctx.entities);
+	free(ctx.names);
+	ctx.scene = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// image loading
+
+static const char * _png_setup()
+{
+	uint32_t * pixels = (uint32_t*)malloc(BENCH_PNG_SIZE * BENCH_PNG_SIZE * 4);
+	for(uint32_t y = 0; y < BENCH_PNG_SIZE; ++y)
+		for(uint32_t x = 0; x < BENCH_PNG_SIZE; ++x)
+			pixels[y * BENCH_PNG_SIZE + x] = ((x ^ y) & 16 ? 0xff203040 : 0xffc0d0e0) + ((x * y) & 7);
+	bool ok = stbi_write_png_fs(BENCH_PNG, BENCH_PNG_SIZE, BENCH_PNG_SIZE, 4, pixels, BENCH_PNG_SIZE * 4) != 0;
+	free(pixels);
+	return ok ? NULL : "can't write " BENCH_PNG;
+}
+
+static void _stbi_fsload(uint32_t i)
+{
+	int w = 0, h = 0, comp = 0;
+	stbi_uc * data = stbi_fsload(BENCH_PNG, &w, &h, &comp, 4);
+	stbi_image_free(data);
+}
+
+static void _png_teardown()
+{
+	remove(BENCH_PNG);
+}
+
+// -----------------------------------------------------------------------------
+
+static const bench_case_t cases[] =
+{
+	{"tr_model_spr", NULL, _tr_model_spr, NULL, 0},
+	{"tr2d_model_spr", NULL, _tr2d_model_spr, NULL, 0},
+	{"r_render_transient/quad", _textures_setup, _r_render_transient, NULL, 1024},
+	{"rb_add+rb_flush/256 sprites", _textures_setup, _rb_add_flush, NULL, 16},
+	{"rb_add+rb_flush/256 sprites sorted", _sorted_setup, _rb_add_flush, _sorted_teardown, 16},
+	{"r_9slice", _textures_setup, _r_9slice, NULL, 1024},
+	{"r_text_ex2/same 24pt", _text_setup, _r_text_same, NULL, 256},
+	{"r_text_ex2/64 strings 24pt", _text_setup, _r_text_varying, NULL, 256},
+	{"dparsey/256 entities", _dparsey_setup, _dparsey, _dparsey_teardown, 0},
+	{"scene_get_entities_for_prefix/1024", _scene_setup, _scene_get_entities_for_prefix, _scene_teardown, 0},
+	{"stbi_fsload/png 256x256", _png_setup, _stbi_fsload, _png_teardown, 0},
+};
+
+int32_t game_init(int32_t argc, char * argv[])
+{
+	ctx.min_time = BENCH_MIN_TIME;
+	ctx.font_file = BENCH_FONT;
+	ctx.out = stdout;
+	for(int32_t i = 1; i + 1 < argc; ++i)
+	{
+		if(!strcmp(argv[i], "--filter"))
+			ctx.filter = argv[++i];
+		else if(!strcmp(argv[i], "--time"))
+			ctx.min_time = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--font"))
+			ctx.font_file = argv[++i];
+		else if(!strcmp(argv[i], "--out"))
+		{
+			ctx.out = fopen(argv[++i], "w");
+			if(!ctx.out)
+			{
+				ep_log("can't open %s\n", argv[i]);
+				return 1;
+			}
+		}
+	}
+
+	_frame();
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+		_run(cases + i);
+	_textures_teardown();
+
+	if(ctx.out != stdout)
+		fclose(ctx.out);
+	return 0;
+}
+
+int32_t game_deinit()
+{
+	return 0;
+}
+
+int32_t game_might_unload()
+{
+	return 0;
+}
+
+int32_t game_update(uint16_t w, uint16_t h, float dt)
+{
+	return 1; // everything is done in game_init
+}
+
+int32_t game_render(uint16_t w, uint16_t h, float dt)
+{
+	return 0;
+}
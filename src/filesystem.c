@@ -7,9 +7,24 @@
 #include <string.h>
 #endif
 
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define FS_MMAP
+#elif !defined(EMSCRIPTEN) && !defined(__ANDROID__) // android assets live inside apk
+#include <sys/mman.h>
+#include <unistd.h>
+#define FS_MMAP
+#endif
+
 #if (!defined(__APPLE__) || !TARGET_OS_IOS) && (!defined(__ANDROID__))
 FILE * fsopen(const char * filename, const char * mode)
 {
+	FILE * packed = _fs_pak_open(filename, mode);
+	if(packed)
+		return packed;
+
 	#ifdef EMSCRIPTEN
 	// TODO remove this hack
 	if(memcmp(filename, "res/", 4) == 0)
@@ -41,6 +56,113 @@ FILE * fsopen_gamesave(const char * filename, const char * mode)
 }
 #endif
 
+static bool _fsmap_read(const char * filename, fsmap_t * out)
+{
+	FILE * f = fsopen(filename, "rb");
+	if(!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	size_t size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	uint8_t * data = (uint8_t*)malloc(size ? size : 1);
+	if(data && size && fread(data, size, 1, f) != 1)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+
+	out->data = data;
+	out->size = size;
+	out->source = FSMAP_HEAP;
+	return data != NULL;
+}
+
+bool fsmap(const char * filename, fsmap_t * out)
+{
+	memset(out, 0, sizeof(fsmap_t));
+
+	if(_fs_pak_map(filename, out))
+		return true;
+
+	#if defined(FS_MMAP) && defined(_WIN32)
+	char path[1024];
+	_fs_path(filename, path, sizeof(path));
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		HANDLE mapping = NULL;
+		if(GetFileSizeEx(file, &size) && size.QuadPart)
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+
+		if(mapping)
+		{
+			out->data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping); // view keeps mapping alive
+			if(out->data)
+			{
+				out->size = (size_t)size.QuadPart;
+				out->source = FSMAP_MAPPED;
+				return true;
+			}
+		}
+	}
+	#elif defined(FS_MMAP)
+	char path[1024];
+	_fs_path(filename, path, sizeof(path));
+
+	int fd = open(path, O_RDONLY);
+	if(fd >= 0)
+	{
+		struct stat st;
+		void * data = MAP_FAILED;
+		if(fstat(fd, &st) == 0 && st.st_size > 0)
+			data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // mapping stays valid
+
+		if(data != MAP_FAILED)
+		{
+			out->data = (const uint8_t*)data;
+			out->size = (size_t)st.st_size;
+			out->source = FSMAP_MAPPED;
+			return true;
+		}
+	}
+	#elif defined(__ANDROID__)
+	if(_fs_asset_map(filename, out))
+		return true;
+	#endif
+
+	return _fsmap_read(filename, out);
+}
+
+void fsunmap(fsmap_t * map)
+{
+	if(!map->data)
+		return;
+
+	#if defined(FS_MMAP) && defined(_WIN32)
+	if(map->source == FSMAP_MAPPED)
+		UnmapViewOfFile(map->data);
+	#elif defined(FS_MMAP)
+	if(map->source == FSMAP_MAPPED)
+		munmap((void*)map->data, map->size);
+	#elif defined(__ANDROID__)
+	if(map->source == FSMAP_MAPPED)
+		_fs_asset_unmap(map);
+	#endif
+
+	if(map->source == FSMAP_HEAP)
+		free((void*)map->data);
+
+	memset(map, 0, sizeof(fsmap_t));
+}
+
 STBIDEF stbi_uc * stbi_fsload(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
 	FILE * f = fsopen(filename, "rb");
@@ -61,7 +183,7 @@ static void _write_to_fsopen(void * context, void * data, int size)
 	}
 }
 
-//STBIWDEF int stbi_write_png_fs(char const * filename, int w, int h, int comp, const void * data, int stride_in_bytes)
-//{
-//	return stbi_write_png_to_func(_write_to_fsopen, (void*)filename, w, h, comp, data, stride_in_bytes);
-//}
+STBIWDEF int stbi_write_png_fs(char const * filename, int w, int h, int comp, const void * data, int stride_in_bytes)
+{
+	return stbi_write_png_to_func(_write_to_fsopen, (void*)filename, w, h, comp, data, stride_in_bytes);
+}
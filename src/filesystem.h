@@ -3,12 +3,40 @@
 // -----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 // please use this instead of fopen
 // because files might be in a different place than you expect
 // on some platforms this might end up doing fmemopen or similar
 FILE * fsopen(const char * filename, const char * mode);
 
+// read only view of a whole file, memory mapped where we can, read into memory otherwise
+// data stays valid until fsunmap, might be called from any thread
+#define FSMAP_HEAP		0
+#define FSMAP_MAPPED	1
+#define FSMAP_PAK		2 // points into mounted archive
+typedef struct
+{
+	const uint8_t * data;
+	size_t size;
+	uint8_t source;
+} fsmap_t;
+bool fsmap(const char * filename, fsmap_t * out);
+void fsunmap(fsmap_t * map);
+
+// packed archive built with tools/pak.py, its files are served by fsopen and fsmap before loose ones
+// paths are looked up exactly as they are passed to fsopen, e.g. "res/image.png"
+bool fsmount(const char * filename);
+void fsunmount();
+
+FILE * _fs_pak_open(const char * filename, const char * mode);
+bool _fs_pak_map(const char * filename, fsmap_t * out);
+
+// android only, maps assets stored uncompressed in apk (like paks) straight from it instead of copying them
+bool _fs_asset_map(const char * filename, fsmap_t * out);
+void _fs_asset_unmap(fsmap_t * map);
+
 // TODO remove this
 void _fs_path(const char * filename, char * buf, size_t size);
 
@@ -23,5 +51,5 @@ FILE * fsopen_gamesave(const char * filename, const char * mode);
 #include <stb_image.h>
 STBIDEF stbi_uc * stbi_fsload(char const * filename, int * x, int * y, int * comp, int req_comp);
 
-//#include <stb_image_write.h>
-//STBIWDEF int stbi_write_png_fs(char const * filename, int w, int h, int comp, const void * data, int stride_in_bytes);
+#include <stb_image_write.h>
+STBIWDEF int stbi_write_png_fs(char const * filename, int w, int h, int comp, const void * data, int stride_in_bytes);
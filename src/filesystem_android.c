@@ -8,6 +8,8 @@
 #include "portable.h"
 
 #include <android/asset_manager_jni.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 static int asset_read(void * asset, char * buf, int size) {return asset ? AAsset_read((AAsset*)asset, buf, size) : 0;}
 static fpos_t asset_seek(void * asset, fpos_t pos, int dir) {return asset ? AAsset_seek((AAsset*)asset, pos, dir) : 0;}
@@ -15,6 +17,10 @@ static int asset_close(void * asset) {if(asset) {AAsset_close((AAsset*)asset); r
 
 FILE * fsopen(const char * filename, const char * mode)
 {
+	FILE * packed = _fs_pak_open(filename, mode);
+	if(packed)
+		return packed;
+
 	// TODO remove this hack
 	if(memcmp(filename, "res/", 4) == 0)
 		filename = filename + 4;
@@ -40,6 +46,50 @@ void _fs_path(const char * filename, char * buf, size_t size)
 	snprintf(buf, size, "file:///android_asset/%s", filename);
 }
 
+bool _fs_asset_map(const char * filename, fsmap_t * out)
+{
+	// TODO remove this hack
+	if(memcmp(filename, "res/", 4) == 0)
+		filename = filename + 4;
+	else
+		return false;
+
+	if(!ep_ctx()->app || !ep_ctx()->app->activity || !ep_ctx()->app->activity->assetManager)
+		return false;
+
+	AAsset * asset = AAssetManager_open(ep_ctx()->app->activity->assetManager, filename, AASSET_MODE_UNKNOWN);
+	if(!asset)
+		return false;
+
+	// fails for compressed assets, keep paks uncompressed in apk (noCompress) to map them
+	off64_t start = 0, length = 0;
+	int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+	AAsset_close(asset);
+	if(fd < 0)
+		return false;
+
+	// asset is somewhere inside apk, mapping has to start on a page boundary
+	off64_t delta = start % sysconf(_SC_PAGESIZE);
+	void * data = MAP_FAILED;
+	if(length > 0)
+		data = mmap64(NULL, (size_t)(length + delta), PROT_READ, MAP_PRIVATE, fd, start - delta);
+	close(fd); // mapping stays valid
+
+	if(data == MAP_FAILED)
+		return false;
+
+	out->data = (const uint8_t*)data + delta;
+	out->size = (size_t)length;
+	out->source = FSMAP_MAPPED;
+	return true;
+}
+
+void _fs_asset_unmap(fsmap_t * map)
+{
+	size_t delta = (uintptr_t)map->data % sysconf(_SC_PAGESIZE);
+	munmap((void*)(map->data - delta), map->size + delta);
+}
+
 FILE * fsopen_gamesave(const char * filename, const char * mode)
 {
 	return NULL;
@@ -8,6 +8,10 @@
 
 FILE * fsopen(const char * filename, const char * mode)
 {
+	FILE * packed = _fs_pak_open(filename, mode);
+	if(packed)
+		return packed;
+
 	char buf[1024 * 2] = {0};
 	_fs_path(filename, buf, sizeof(buf));
 	return fopen(buf, mode);
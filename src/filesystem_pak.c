@@ -0,0 +1,258 @@
+#include "filesystem.h"
+#include "portable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// archive built with tools/pak.py, all numbers are little endian
+// header | index sorted by hash | entries aligned to 16 bytes
+
+#define PAK_MAGIC "LEPK"
+#define PAK_VERSION (1)
+
+#pragma pack(push, 1)
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t flags;
+} pak_header_t;
+
+typedef struct
+{
+	uint64_t hash;		// fnv1a 64 of path
+	uint64_t offset;	// from start of archive
+	uint32_t size;		// original size
+	uint32_t stored_size; // differs from size if entry is lz4 compressed
+} pak_entry_t;
+#pragma pack(pop)
+
+static struct
+{
+	fsmap_t file;
+	const pak_entry_t * index;
+	uint32_t count;
+} ctx = {0};
+
+static uint64_t _hash(const char * str)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(; *str; ++str)
+		h = (h ^ (uint8_t)*str) * 0x100000001b3ull;
+	return h;
+}
+
+static const pak_entry_t * _find(const char * filename)
+{
+	if(!ctx.count)
+		return NULL;
+
+	uint64_t h = _hash(filename);
+
+	// hashes are uniform, so position is predictable from the value and only a few steps are needed
+	size_t i = (size_t)((double)h / 18446744073709551616.0 * ctx.count);
+	if(i >= ctx.count)
+		i = ctx.count - 1;
+	while(i > 0 && ctx.index[i].hash > h)
+		--i;
+	while(i + 1 < ctx.count && ctx.index[i].hash < h)
+		++i;
+
+	return ctx.index[i].hash == h ? ctx.index + i : NULL;
+}
+
+// plain lz4 block format
+static bool _lz4_decompress(const uint8_t * src, size_t src_size, uint8_t * dst, size_t dst_size)
+{
+	const uint8_t * ip = src, * iend = src + src_size;
+	uint8_t * op = dst, * oend = dst + dst_size;
+
+	while(ip < iend)
+	{
+		uint8_t token = *ip++;
+
+		size_t lit = token >> 4;
+		if(lit == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if(ip >= iend)
+					return false;
+				b = *ip++;
+				lit += b;
+			} while(b == 255);
+		}
+		if(lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+			return false;
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+
+		if(ip >= iend) // last sequence has only literals
+			break;
+
+		if(iend - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(!offset || offset > (size_t)(op - dst))
+			return false;
+
+		size_t len = token & 15;
+		if(len == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if(ip >= iend)
+					return false;
+				b = *ip++;
+				len += b;
+			} while(b == 255);
+		}
+		len += 4;
+		if(len > (size_t)(oend - op))
+			return false;
+
+		// match might overlap with output
+		const uint8_t * m = op - offset;
+		while(len--)
+			*op++ = *m++;
+	}
+
+	return op == oend;
+}
+
+bool fsmount(const char * filename)
+{
+	fsunmount();
+
+	fsmap_t file;
+	if(!fsmap(filename, &file))
+		return false;
+
+	const pak_header_t * header = (const pak_header_t*)file.data;
+	if(file.size < sizeof(pak_header_t) || memcmp(header->magic, PAK_MAGIC, 4) || header->version != PAK_VERSION
+		|| file.size < sizeof(pak_header_t) + (uint64_t)header->count * sizeof(pak_entry_t))
+	{
+		ep_log("%s: %s is not a valid archive\n", __func__, filename);
+		fsunmap(&file);
+		return false;
+	}
+
+	ctx.file = file;
+	ctx.index = (const pak_entry_t*)(file.data + sizeof(pak_header_t));
+	ctx.count = header->count;
+	return true;
+}
+
+void fsunmount()
+{
+	fsunmap(&ctx.file);
+	ctx.index = NULL;
+	ctx.count = 0;
+}
+
+bool _fs_pak_map(const char * filename, fsmap_t * out)
+{
+	const pak_entry_t * e = _find(filename);
+	if(!e || e->offset + e->stored_size > ctx.file.size)
+		return false;
+
+	memset(out, 0, sizeof(fsmap_t));
+	const uint8_t * src = ctx.file.data + e->offset;
+
+	if(e->stored_size == e->size)
+	{
+		// points straight into archive, valid while it's mounted
+		out->data = src;
+		out->size = e->size;
+		out->source = FSMAP_PAK;
+		return true;
+	}
+
+	uint8_t * data = (uint8_t*)malloc(e->size ? e->size : 1);
+	if(!data || !_lz4_decompress(src, e->stored_size, data, e->size))
+	{
+		ep_log("%s: failed to decompress %s\n", __func__, filename);
+		free(data);
+		return false;
+	}
+
+	out->data = data;
+	out->size = e->size;
+	out->source = FSMAP_HEAP;
+	return true;
+}
+
+#ifdef _WIN32
+// msvc tmpfile creates files in root of the drive, which needs admin rights
+static FILE * _tmpfile()
+{
+	char dir[MAX_PATH], path[MAX_PATH];
+	DWORD len = GetTempPathA(sizeof(dir), dir);
+	if(!len || len >= sizeof(dir) || !GetTempFileNameA(dir, "lep", 0, path))
+		return NULL;
+
+	// deleted by system once last handle is closed, so fclose cleans it up
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		DeleteFileA(path);
+		return NULL;
+	}
+
+	int fd = _open_osfhandle((intptr_t)file, _O_RDWR | _O_BINARY);
+	if(fd < 0)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	FILE * f = _fdopen(fd, "w+b");
+	if(!f)
+		_close(fd);
+	return f;
+}
+#endif
+
+FILE * _fs_pak_open(const char * filename, const char * mode)
+{
+	if(!ctx.count || strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+		return NULL;
+
+	fsmap_t map;
+	if(!_fs_pak_map(filename, &map))
+		return NULL;
+
+	FILE * f = NULL;
+
+	#ifndef _WIN32
+	if(map.source == FSMAP_PAK && map.size)
+		return fmemopen((void*)map.data, map.size, "rb");
+	#endif
+
+	// decompressed data has to be owned by the stream, so it's copied into one which frees itself on fclose
+	#ifdef _WIN32
+	f = _tmpfile();
+	#else
+	f = fmemopen(NULL, map.size + 1, "w+b"); // some libc reserve last byte for null terminator
+	#endif
+
+	if(f)
+	{
+		fwrite(map.data, 1, map.size, f);
+		rewind(f);
+	}
+
+	fsunmap(&map);
+	return f;
+}
@@ -1,6 +1,14 @@
 
 #include "portable.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
 #if !defined(__FreeBSD__) && !defined(EMSCRIPTEN) && !defined(__APPLE__)
 
 size_t strlcpy(char * dst, const char * src, size_t size)
@@ -48,6 +56,40 @@ errno_t memset_s(void *v, rsize_t smax, int c, rsize_t n)
 }
 #endif
 
+#if defined(_WIN32)
+
+double hp_time()
+{
+	static LARGE_INTEGER freq = {0};
+	if(!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+#elif defined(__APPLE__)
+
+double hp_time()
+{
+	static mach_timebase_info_data_t info = {0};
+	if(!info.denom)
+		mach_timebase_info(&info);
+
+	return (double)mach_absolute_time() * info.numer / info.denom / 1000000000.0;
+}
+
+#else
+
+double hp_time()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+#endif
 
 #if defined(BIG_ENDIAN) // TODO fix this when we ever compile to big endian platform
 
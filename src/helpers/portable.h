@@ -48,6 +48,9 @@ bool endswith(const char * string_ends, const char * with_prefix);
 errno_t memset_s(void * v, rsize_t smax, int c, rsize_t n);
 #endif
 
+// monotonic time in seconds with high precision, only differences are meaningful
+double hp_time();
+
 uint16_t read_bigendian_16(const uint8_t * i);
 void write_bigendian_16(uint16_t i, uint8_t * o);
 
@@ -0,0 +1,217 @@
+#include "profiler.h"
+
+#ifdef PROFILER
+
+#include "filesystem.h"
+#include "portable.h"
+#include <tinycthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(EMSCRIPTEN) && !defined(NO_THREADS)
+#define PF_THREADS
+#endif
+
+#ifndef PF_RING_SIZE
+#define PF_RING_SIZE (16 * 1024) // zones per thread
+#endif
+#ifndef PF_MAX_DEPTH
+#define PF_MAX_DEPTH (32) // deeper zones are not recorded
+#endif
+
+typedef struct
+{
+	const char * name;
+	double start, end;
+} pf_zone_t;
+
+// owned by profiler, stays alive after thread exits so its zones still end up in trace
+typedef struct pf_thread_t
+{
+	pf_zone_t ring[PF_RING_SIZE];
+	uint32_t head; // next zone to write
+	uint32_t count;
+
+	pf_zone_t stack[PF_MAX_DEPTH]; // open zones
+	uint32_t depth;
+
+	const char * name;
+	uint32_t id;
+	struct pf_thread_t * next;
+} pf_thread_t;
+
+static struct
+{
+	#ifdef PF_THREADS
+	mtx_t lock;
+	#endif
+	pf_thread_t * threads;
+	uint32_t threads_count;
+	double epoch;
+	bool started;
+} ctx;
+
+static _Thread_local pf_thread_t * tls = NULL;
+
+void _pf_init()
+{
+	#ifdef PF_THREADS
+	mtx_init(&ctx.lock, mtx_plain);
+	#endif
+	ctx.epoch = hp_time();
+	ctx.started = true;
+	pf_thread("main");
+}
+
+void _pf_deinit()
+{
+	if(!ctx.started)
+		return;
+
+	// workers are joined by now, so every ring can go
+	pf_thread_t * t = ctx.threads;
+	while(t)
+	{
+		pf_thread_t * next = t->next;
+		free(t);
+		t = next;
+	}
+
+	#ifdef PF_THREADS
+	mtx_destroy(&ctx.lock);
+	#endif
+	memset(&ctx, 0, sizeof(ctx));
+	tls = NULL;
+}
+
+static pf_thread_t * _thread()
+{
+	if(tls || !ctx.started)
+		return tls;
+
+	pf_thread_t * t = (pf_thread_t*)calloc(1, sizeof(pf_thread_t));
+	if(!t)
+		return NULL;
+
+	#ifdef PF_THREADS
+	mtx_lock(&ctx.lock);
+	#endif
+	t->id = ++ctx.threads_count;
+	t->next = ctx.threads;
+	ctx.threads = t;
+	#ifdef PF_THREADS
+	mtx_unlock(&ctx.lock);
+	#endif
+
+	tls = t;
+	return t;
+}
+
+void pf_begin(const char * name)
+{
+	pf_thread_t * t = _thread();
+	if(!t)
+		return;
+
+	if(t->depth < PF_MAX_DEPTH)
+	{
+		t->stack[t->depth].name = name;
+		t->stack[t->depth].start = hp_time();
+	}
+	t->depth++;
+}
+
+void pf_end()
+{
+	pf_thread_t * t = tls;
+	if(!t || !t->depth)
+		return;
+
+	if(--t->depth >= PF_MAX_DEPTH)
+		return;
+
+	pf_zone_t * z = t->ring + t->head;
+	*z = t->stack[t->depth];
+	z->end = hp_time();
+	t->head = (t->head + 1) % PF_RING_SIZE;
+	if(t->count < PF_RING_SIZE)
+		t->count++;
+}
+
+void pf_thread(const char * name)
+{
+	pf_thread_t * t = _thread();
+	if(t)
+		t->name = name;
+}
+
+static void _write_str(FILE * f, const char * str)
+{
+	fputc('"', f);
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\')
+			fputc('\\', f);
+		if((unsigned char)*str >= 0x20)
+			fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+bool pf_write_trace(const char * filename)
+{
+	if(!ctx.started)
+		return false;
+
+	FILE * f = fsopen_gamesave(filename, "wb");
+	if(!f)
+		return false;
+
+	#ifdef PF_THREADS
+	mtx_lock(&ctx.lock);
+	#endif
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for(pf_thread_t * t = ctx.threads; t; t = t->next)
+	{
+		if(t->name)
+		{
+			fprintf(f, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", t->id);
+			_write_str(f, t->name);
+			fprintf(f, "}}");
+			first = false;
+		}
+
+		// oldest first, timestamps are in microseconds since _pf_init
+		uint32_t count = t->count, start = (t->head + PF_RING_SIZE - count) % PF_RING_SIZE;
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			const pf_zone_t * z = t->ring + (start + i) % PF_RING_SIZE;
+			fprintf(f, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", first ? "" : ",\n",
+				t->id, (z->start - ctx.epoch) * 1000000.0, (z->end - z->start) * 1000000.0);
+			_write_str(f, z->name);
+			fputc('}', f);
+			first = false;
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	#ifdef PF_THREADS
+	mtx_unlock(&ctx.lock);
+	#endif
+
+	return fclose(f) == 0;
+}
+
+#else
+
+void _pf_init() {}
+void _pf_deinit() {}
+void pf_begin(const char * name) {}
+void pf_end() {}
+void pf_thread(const char * name) {}
+bool pf_write_trace(const char * filename) {return false;}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// cpu frame profiler, zones of every thread go into its own ring buffer and are exported as chrome trace json
+// open with chrome://tracing or ui.perfetto.dev
+// only built with PROFILER (cmake option), otherwise macros are empty and nothing is evaluated
+// - zone names must be string literals or live until pf_write_trace
+// - zones nest, but each PF_BEGIN needs PF_END on the same thread
+// - only last PF_RING_SIZE zones of each thread are kept, so dump right after a hitch
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef PROFILER
+#define PF_BEGIN(name)	pf_begin(name)
+#define PF_END()		pf_end()
+#define PF_THREAD(name)	pf_thread(name)
+#else
+#define PF_BEGIN(name)	((void)0)
+#define PF_END()		((void)0)
+#define PF_THREAD(name)	((void)0)
+#endif
+
+void _pf_init(); // main thread is named "main"
+void _pf_deinit();
+
+void pf_begin(const char * name);
+void pf_end();
+void pf_thread(const char * name); // names current thread in trace
+
+// zones closed so far, others threads should be idle or their newest zones might be torn
+bool pf_write_trace(const char * filename);
@@ -4,9 +4,31 @@
 #include <string.h>
 #include SHADER_INCLUDE_VS
 #include SHADER_INCLUDE_FS
+#include SHADER_INCLUDE_TEXT_FS
+#include SHADER_INCLUDE_SDF_FS
 #include <entrypoint.h>
 #include "filesystem.h"
 #include "render_batch.h"
+#include "render_vertex.h"
+#include "render_atlas.h"
+#include "render_text.h"
+#include "render_soft.h"
+#include "profiler.h"
+#include "portable.h"
+#include <stdlib.h>
+
+#if !defined(EMSCRIPTEN) && !defined(NO_THREADS)
+#define R_ASYNC
+#include <tinycthread.h>
+#include <khash.h>
+#ifndef R_ASYNC_WORKERS
+#define R_ASYNC_WORKERS (2)
+#endif
+#endif
+
+#ifndef R_SCISSORS_STACK
+#define R_SCISSORS_STACK (16)
+#endif
 #include "_missing_texture.h"
 
 r_color_t r_color(float r, float g, float b, float a)
@@ -63,14 +85,30 @@ static struct
 	bgfx_vertex_decl_t			vert_decl;
 	bgfx_uniform_handle_t		s_texture;
 	bgfx_program_handle_t		prog;
+	bgfx_program_handle_t		prog_text;
+	bgfx_program_handle_t		prog_sdf;
 	tex_t						white_tex;
 	uint8_t						viewid;
 	uint32_t					view_color;
 	uint16_t					view_x, view_y, view_w, view_h;
 
 	bool hint_no_alpha;
+
+	uint16_t scissors[R_SCISSORS_STACK][4];
+	uint8_t scissors_count;
+
+	float cull_x1, cull_y1, cull_x2, cull_y2; // visible area in world space, viewport and scissors
+	uint16_t cull_scissor[4];
+	trns_t cull_vpv; // view the area was computed for
+	bool cull_stale;
+
+	r_stats_t stats;		// current frame
+	r_stats_t stats_last;	// previous frame
 } ctx;
 
+static void _async_finish();
+static void _async_deinit();
+
 void _r_init()
 {
 	bgfx_vertex_decl_begin(&ctx.vert_decl, BGFX_RENDERER_TYPE_NOOP);
@@ -85,10 +123,22 @@ void _r_init()
 	// TODO support others
 	bgfx_shader_handle_t vs = bgfx_create_shader(bgfx_make_ref(tex_color_vs, sizeof(tex_color_vs)));
 	bgfx_shader_handle_t fs = bgfx_create_shader(bgfx_make_ref(tex_color_fs, sizeof(tex_color_fs)));
-	ctx.prog = bgfx_create_program(vs, fs, true);
+	bgfx_shader_handle_t fs_text = bgfx_create_shader(bgfx_make_ref(text_fs, sizeof(text_fs)));
+	bgfx_shader_handle_t fs_sdf = bgfx_create_shader(bgfx_make_ref(text_sdf_fs, sizeof(text_sdf_fs)));
+	ctx.prog = bgfx_create_program(vs, fs, false);
+	ctx.prog_text = bgfx_create_program(vs, fs_text, false);
+	ctx.prog_sdf = bgfx_create_program(vs, fs_sdf, false);
+
+	// vertex shader is shared, programs keep shaders alive
+	bgfx_destroy_shader(vs);
+	bgfx_destroy_shader(fs);
+	bgfx_destroy_shader(fs_text);
+	bgfx_destroy_shader(fs_sdf);
 
 	static r_color_t white_color = 0xffffffff;
-	ctx.white_tex.tex = bgfx_create_texture_2d(1, 1, false, 0, BGFX_TEXTURE_FORMAT_RGBA8, BGFX_TEXTURE_U_MIRROR | BGFX_TEXTURE_W_MIRROR | BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIN_POINT, bgfx_make_ref(&white_color, sizeof(white_color)));
+	uint32_t white_flags = BGFX_TEXTURE_U_MIRROR | BGFX_TEXTURE_W_MIRROR | BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIN_POINT;
+	ctx.white_tex.tex = bgfx_create_texture_2d(1, 1, false, 0, BGFX_TEXTURE_FORMAT_RGBA8, white_flags, bgfx_make_ref(&white_color, sizeof(white_color)));
+	rs_texture(ctx.white_tex.tex, 1, 1, BGFX_TEXTURE_FORMAT_RGBA8, white_flags, &white_color);
 	ctx.white_tex.w = 1; ctx.white_tex.h = 1;
 	ctx.white_tex.pixel_w = 1; ctx.white_tex.h = 1;
 	ctx.white_tex.u1 = 0.0f; ctx.white_tex.v1 = 0.0f;
@@ -99,9 +149,14 @@ void _r_init()
 
 void _r_deinit()
 {
+	_async_deinit();
 	rb_deinit();
+	ra_deinit();
+	rs_deinit();
 	bgfx_destroy_texture(ctx.white_tex.tex);
 	bgfx_destroy_program(ctx.prog);
+	bgfx_destroy_program(ctx.prog_text);
+	bgfx_destroy_program(ctx.prog_sdf);
 	bgfx_destroy_uniform(ctx.s_texture);
 }
 
@@ -112,50 +167,111 @@ static bool _ends_with(const char * str, const char * ext)
 	return (str_len >= suffix_len) && (!strcmp(str + (str_len - suffix_len), ext));
 }
 
-tex_t r_load(const char * filename, uint32_t flags)
+// decoded file, can be produced on any thread
+typedef struct
 {
-	tex_t ret = {0};
+	uint8_t * data;		// ownership goes to bgfx with a release callback
+	uint32_t size;
+	uint16_t w, h;		// unknown for ktx, bgfx reads them from header
+	fsmap_t * ktx;		// ktx file is passed to bgfx as is, data points into it
+} r_decoded_t;
+
+static void _release_fsmap(void * ptr, void * user) {fsunmap((fsmap_t*)user); free(user);}
+static void _release_stbi(void * ptr, void * user) {stbi_image_free(ptr);}
+
+static void _decoded_free(r_decoded_t * d)
+{
+	if(d->ktx)
+		_release_fsmap(d->data, d->ktx);
+	else if(d->data)
+		stbi_image_free(d->data);
+	memset(d, 0, sizeof(r_decoded_t));
+}
+
+static bool _read_ktx(const char * filename, r_decoded_t * out)
+{
+	fsmap_t * map = (fsmap_t*)malloc(sizeof(fsmap_t));
+	if(!fsmap(filename, map))
+	{
+		free(map);
+		return false;
+	}
+
+	out->data = (uint8_t*)map->data;
+	out->size = (uint32_t)map->size;
+	out->ktx = map;
+	return true;
+}
 
-	// TODO prefer loading ktx over other formats
+static bool _decode(const char * filename, r_decoded_t * out)
+{
+	memset(out, 0, sizeof(r_decoded_t));
+
+	if(_ends_with(filename, ".ktx")) // native bgfx format
+		return _read_ktx(filename, out);
+
+	// prefer precompressed sibling, see tools/ktx.py
+	char ktx_filename[256];
+	// only dots in the file name count, not in directories like "res/v1.2/image"
+	const char * name = filename;
+	for(const char * c = filename; *c; ++c)
+		if(*c == '/' || *c == '\\')
+			name = c + 1;
+	const char * ext = strrchr(name, '.');
+	size_t len = ext ? (size_t)(ext - filename) : strlen(filename);
+	if(len + sizeof(".ktx") <= sizeof(ktx_filename))
+	{
+		memcpy(ktx_filename, filename, len);
+		strcpy(ktx_filename + len, ".ktx");
+		if(_read_ktx(ktx_filename, out))
+			return true;
+		memset(out, 0, sizeof(r_decoded_t));
+	}
+
+	int x = 0, y = 0, comp = 0;
+	out->data = stbi_fsload(filename, &x, &y, &comp, 4);
+	out->w = (uint16_t)x;
+	out->h = (uint16_t)y;
+	out->size = x * y * 4;
+
+	return out->data != NULL;
+}
+
+// must be called on render thread, takes ownership of decoded data
+static tex_t _create(const char * filename, r_decoded_t * d, uint32_t flags)
+{
+	tex_t ret = {0};
 
 	uint32_t tex_flags = BGFX_TEXTURE_NONE
 			| BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP
 			| (flags & TEX_FLAGS_POINT  ? (BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIN_POINT) : 0)
 			| (flags & TEX_FLAGS_REPEAT ? (BGFX_TEXTURE_U_MIRROR | BGFX_TEXTURE_W_MIRROR) : 0);
 
-	if(_ends_with(filename, ".ktx")) // native bgfx format
+	if(d->data && d->ktx)
 	{
-		FILE * f = fsopen(filename, "rb");
-		if(f)
-		{
-			fseek(f, 0, SEEK_END);
-			const bgfx_memory_t * mem = bgfx_alloc(ftell(f));
-			fseek(f, 0, SEEK_SET);
-			fread(mem->data, mem->size, 1, f);
-			fclose(f);
-
-			bgfx_texture_info_t t;
-			ret.tex = bgfx_create_texture(mem, tex_flags, 0, &t);
-			ret.pixel_w = t.width;
-			ret.pixel_h = t.height;
-		}
+		bgfx_texture_info_t t;
+		ret.tex = bgfx_create_texture(bgfx_make_ref_release(d->data, d->size, _release_fsmap, d->ktx), tex_flags, 0, &t);
+		rs_texture_ktx(ret.tex, d->data, d->size, tex_flags); // data is released only after next bgfx_frame
+		ret.pixel_w = t.width;
+		ret.pixel_h = t.height;
 	}
-	else
+	else if(d->data)
 	{
-		int x = 0, y = 0, comp = 0;
-		stbi_uc * bytes = stbi_fsload(filename, &x, &y, &comp, 4);
-
-		if(bytes)
+		#ifndef NO_ATLAS
+		if(ra_add(d->data, d->w, d->h, flags, &ret))
 		{
-			// TODO do we really need a copy here?
-			// TODO generate mipmaps on a fly?
-
-			ret.tex = bgfx_create_texture_2d(x, y, false, 1, BGFX_TEXTURE_FORMAT_RGBA8, tex_flags, bgfx_copy(bytes, x * y * 4));
-			ret.pixel_w = x;
-			ret.pixel_h = y;
-			stbi_image_free(bytes);
+			stbi_image_free(d->data);
+			return ret;
 		}
+		#endif
+
+		// TODO generate mipmaps on a fly?
+		ret.tex = bgfx_create_texture_2d(d->w, d->h, false, 1, BGFX_TEXTURE_FORMAT_RGBA8, tex_flags, bgfx_make_ref_release(d->data, d->size, _release_stbi, NULL));
+		rs_texture(ret.tex, d->w, d->h, BGFX_TEXTURE_FORMAT_RGBA8, tex_flags, d->data);
+		ret.pixel_w = d->w;
+		ret.pixel_h = d->h;
 	}
+	d->data = NULL;
 
 	if(ret.tex.idx == 0 || ret.pixel_w == 0 || ret.pixel_h == 0)
 	{
@@ -163,6 +279,7 @@ tex_t r_load(const char * filename, uint32_t flags)
 
 		bgfx_texture_info_t t;
 		ret.tex = bgfx_create_texture(bgfx_make_ref(_missing_texture, sizeof(_missing_texture)), BGFX_TEXTURE_NONE, 0, &t);
+		rs_texture_ktx(ret.tex, _missing_texture, sizeof(_missing_texture), BGFX_TEXTURE_NONE);
 		ret.pixel_w = t.width;
 		ret.pixel_h = t.height;
 		assert(ret.tex.idx && ret.pixel_w && ret.pixel_h);
@@ -175,11 +292,244 @@ tex_t r_load(const char * filename, uint32_t flags)
 	return ret;
 }
 
+tex_t r_load(const char * filename, uint32_t flags)
+{
+	PF_BEGIN("r_load");
+	r_decoded_t d;
+	_decode(filename, &d);
+	tex_t tex = _create(filename, &d, flags);
+	PF_END();
+	return tex;
+}
+
+#ifdef R_ASYNC
+
+typedef struct r_async_job_t
+{
+	char filename[256];
+	uint32_t flags;
+	tex_t * out; // NULL if cancelled, result is dropped then
+	r_decoded_t decoded;
+	struct r_async_job_t * next;
+} r_async_job_t;
+
+KHASH_MAP_INIT_INT64(r_async_map, r_async_job_t*) // out -> job, for every job which isn't resolved yet
+
+static struct
+{
+	thrd_t workers[R_ASYNC_WORKERS];
+	bool started;
+	bool quit;
+
+	mtx_t lock;
+	cnd_t has_work;
+	cnd_t has_done;
+
+	r_async_job_t * queue_head;
+	r_async_job_t * queue_tail;
+	r_async_job_t * done;
+	uint32_t in_flight; // queued or being decoded
+	kh_r_async_map_t * pending;
+} async;
+
+static int _async_worker(void * arg)
+{
+	PF_THREAD("r_async");
+	mtx_lock(&async.lock);
+	while(true)
+	{
+		while(!async.queue_head && !async.quit)
+			cnd_wait(&async.has_work, &async.lock);
+		if(async.quit)
+			break;
+
+		r_async_job_t * job = async.queue_head;
+		async.queue_head = job->next;
+		if(!async.queue_head)
+			async.queue_tail = NULL;
+		mtx_unlock(&async.lock);
+
+		PF_BEGIN("r_decode");
+		_decode(job->filename, &job->decoded);
+		PF_END();
+
+		mtx_lock(&async.lock);
+		job->next = async.done;
+		async.done = job;
+		async.in_flight--;
+		cnd_broadcast(&async.has_done);
+	}
+	mtx_unlock(&async.lock);
+	return 0;
+}
+
+void r_load_async(const char * filename, uint32_t flags, tex_t * out)
+{
+	if(!async.started)
+	{
+		mtx_init(&async.lock, mtx_plain);
+		cnd_init(&async.has_work);
+		cnd_init(&async.has_done);
+		async.pending = kh_init_r_async_map();
+		for(size_t i = 0; i < R_ASYNC_WORKERS; ++i)
+			thrd_create(async.workers + i, _async_worker, NULL);
+		async.started = true;
+	}
+
+	r_load_cancel(out); // newer load wins
+	*out = ctx.white_tex;
+
+	r_async_job_t * job = (r_async_job_t*)calloc(1, sizeof(r_async_job_t));
+	strlcpy(job->filename, filename, sizeof(job->filename));
+	job->flags = flags;
+	job->out = out;
+
+	mtx_lock(&async.lock);
+	int ret = 0;
+	khint_t k = kh_put_r_async_map(async.pending, (uint64_t)(uintptr_t)out, &ret);
+	kh_value(async.pending, k) = job;
+	if(async.queue_tail)
+		async.queue_tail->next = job;
+	else
+		async.queue_head = job;
+	async.queue_tail = job;
+	async.in_flight++;
+	cnd_signal(&async.has_work);
+	mtx_unlock(&async.lock);
+}
+
+static void _async_finish()
+{
+	if(!async.started)
+		return;
+
+	mtx_lock(&async.lock);
+	r_async_job_t * job = async.done;
+	async.done = NULL;
+	for(r_async_job_t * j = job; j; j = j->next)
+		if(j->out)
+			kh_del_r_async_map(async.pending, kh_get_r_async_map(async.pending, (uint64_t)(uintptr_t)j->out));
+	mtx_unlock(&async.lock);
+
+	while(job)
+	{
+		r_async_job_t * next = job->next;
+		if(job->out)
+		{
+			PF_BEGIN("r_async_create");
+			*job->out = _create(job->filename, &job->decoded, job->flags);
+			PF_END();
+		}
+		else
+			_decoded_free(&job->decoded); // out might be gone already
+		free(job);
+		job = next;
+	}
+}
+
+bool r_load_cancel(tex_t * out)
+{
+	if(!async.started)
+		return false;
+
+	// job stays in queue or done list, it's only detached from out
+	mtx_lock(&async.lock);
+	khint_t k = kh_get_r_async_map(async.pending, (uint64_t)(uintptr_t)out);
+	bool found = k != kh_end(async.pending);
+	if(found)
+	{
+		kh_value(async.pending, k)->out = NULL;
+		kh_del_r_async_map(async.pending, k);
+	}
+	mtx_unlock(&async.lock);
+	return found;
+}
+
+void r_load_wait()
+{
+	if(!async.started)
+		return;
+
+	mtx_lock(&async.lock);
+	while(async.in_flight)
+		cnd_wait(&async.has_done, &async.lock);
+	mtx_unlock(&async.lock);
+
+	_async_finish();
+}
+
+bool r_load_pending()
+{
+	if(!async.started)
+		return false;
+
+	mtx_lock(&async.lock);
+	bool pending = async.in_flight || async.done;
+	mtx_unlock(&async.lock);
+	return pending;
+}
+
+static void _async_deinit()
+{
+	if(!async.started)
+		return;
+
+	r_load_wait();
+
+	mtx_lock(&async.lock);
+	async.quit = true;
+	cnd_broadcast(&async.has_work);
+	mtx_unlock(&async.lock);
+
+	for(size_t i = 0; i < R_ASYNC_WORKERS; ++i)
+		thrd_join(async.workers[i], NULL);
+
+	kh_destroy_r_async_map(async.pending);
+	cnd_destroy(&async.has_done);
+	cnd_destroy(&async.has_work);
+	mtx_destroy(&async.lock);
+	memset(&async, 0, sizeof(async));
+}
+
+#else
+
+void r_load_async(const char * filename, uint32_t flags, tex_t * out)
+{
+	*out = r_load(filename, flags);
+}
+
+void r_load_wait() {}
+bool r_load_pending() {return false;}
+bool r_load_cancel(tex_t * out) {return false;}
+static void _async_finish() {}
+static void _async_deinit() {}
+
+#endif
+
 void r_free(tex_t tex)
 {
+	// placeholder of pending async load, see r_load_cancel
+	if(tex.tex.idx == ctx.white_tex.tex.idx)
+		return;
+
+	#ifndef NO_ATLAS
+	if(ra_free(tex))
+		return;
+	#endif
+	rs_texture_free(tex.tex);
 	bgfx_destroy_texture(tex.tex);
 }
 
+tex_t r_sub_tex(tex_t tex, float u1, float v1, float u2, float v2)
+{
+	float du = tex.u2 - tex.u1, dv = tex.v2 - tex.v1;
+	tex.u2 = tex.u1 + u2 * du;
+	tex.v2 = tex.v1 + v2 * dv;
+	tex.u1 = tex.u1 + u1 * du;
+	tex.v1 = tex.v1 + v1 * dv;
+	return tex;
+}
+
 static void r_setup_viewid(bool first)
 {
 	if(first)
@@ -189,16 +539,56 @@ static void r_setup_viewid(bool first)
 
 	float wf = (float)ctx.view_w / 2.0f, hf = (float)ctx.view_h / 2.0f;
 	tr_set_view_prj(ctx.viewid, tr_ortho(-wf, wf, -hf, hf, -1.0f, 1.0f), tr_identity(), gb_vec2(ctx.view_x, ctx.view_y), gb_vec2(ctx.view_w, ctx.view_h));
+	rs_viewport(ctx.view_x, ctx.view_y, ctx.view_w, ctx.view_h, first, ctx.view_color);
 
 	bgfx_touch(ctx.viewid);
 	bgfx_set_view_mode(ctx.viewid, BGFX_VIEW_MODE_SEQUENTIAL);
 }
 
-static void r_next_viewid()
+static void _cull_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-	rb_flush();
-	++ctx.viewid;
-	r_setup_viewid(false);
+	ctx.cull_scissor[0] = x;
+	ctx.cull_scissor[1] = y;
+	ctx.cull_scissor[2] = w;
+	ctx.cull_scissor[3] = h;
+	ctx.cull_stale = true;
+}
+
+// games might set their own camera with tr_set_view_prj after r_viewport, so area follows current vpv
+static void _cull_update()
+{
+	trns_t vpv = tr_get_vpv();
+	if(!ctx.cull_stale && !memcmp(&vpv, &ctx.cull_vpv, sizeof(trns_t)))
+		return;
+	ctx.cull_vpv = vpv;
+	ctx.cull_stale = false;
+
+	// visible pixels relative to viewport
+	float px1 = 0.0f, py1 = 0.0f, px2 = (float)ctx.view_w, py2 = (float)ctx.view_h;
+	if(ctx.cull_scissor[2] && ctx.cull_scissor[3])
+	{
+		float sx = (float)ctx.cull_scissor[0] - (float)ctx.view_x;
+		float sy = (float)ctx.cull_scissor[1] - (float)ctx.view_y;
+		px1 = gb_max(px1, sx);
+		py1 = gb_max(py1, sy);
+		px2 = gb_min(px2, sx + ctx.cull_scissor[2]);
+		py2 = gb_min(py2, sy + ctx.cull_scissor[3]);
+	}
+
+	// bounds of corners mapped back to world, covers rotated views too
+	trns_t inv;
+	gb_mat4_inverse(&inv, &vpv);
+	const float corners[4][2] = {{px1, py1}, {px2, py1}, {px2, py2}, {px1, py2}};
+	for(uint8_t i = 0; i < 4; ++i)
+	{
+		gbVec4 p;
+		gb_mat4_mul_vec4(&p, &inv, gb_vec4(corners[i][0], corners[i][1], 0.0f, 1.0f));
+		float x = p.x / p.w, y = p.y / p.w;
+		ctx.cull_x1 = i ? gb_min(ctx.cull_x1, x) : x;
+		ctx.cull_x2 = i ? gb_max(ctx.cull_x2, x) : x;
+		ctx.cull_y1 = i ? gb_min(ctx.cull_y1, y) : y;
+		ctx.cull_y2 = i ? gb_max(ctx.cull_y2, y) : y;
+	}
 }
 
 void r_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, r_color_t color)
@@ -213,6 +603,9 @@ void r_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, r_color_t color)
 	r_setup_viewid(true);
 	tr_set_parent_world(tr_identity());
 	rb_start();
+	_async_finish();
+	ctx.scissors_count = 0;
+	_cull_rect(0, 0, 0, 0);
 
 	ctx.hint_no_alpha = false;
 }
@@ -243,18 +636,32 @@ void r_render_hint_no_alpha()
 	ctx.hint_no_alpha = true;
 }
 
+uint64_t r_sprite_state()
+{
+	uint64_t state = BGFX_STATE_DEFAULT_2D;
+
+	if(!ctx.hint_no_alpha)
+		state |= BGFX_STATE_BLEND_ALPHA;
+	ctx.hint_no_alpha = false;
+	return state;
+}
+
 void r_render_sprite(tex_t tex, float x, float y, float r_deg, float sx, float sy)
 {
 	r_render_sprite_ex(tex, x, y, r_deg, 0.0f, 0.0f, sx, sy, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, false);
 }
 
-void r_render_sprite_ex(tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, float r, float g, float b, float a, bool pixel_perfect)
+static trns2d_t _sprite_world(tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, bool pixel_perfect)
 {
 	if(pixel_perfect)
 		r_pixel_perfect_map(&x, &y, tex.w * sx, tex.h * sy);
 
-	tr_set_world(tr_model_spr(x, y, r_deg, rox, roy, sx, sy, sox, soy, tex.w, tex.h, ox, oy));
+	tr_set_world2d(tr2d_model_spr(x, y, r_deg, rox, roy, sx, sy, sox, soy, tex.w, tex.h, ox, oy));
+	return tr_get_world2d();
+}
 
+static void _sprite_fill(vrtx_t out[4], tex_t tex, trns2d_t world, float r, float g, float b, float a)
+{
 	r_color_t color = r_color(r, g, b, a);
 
 	vrtx_t sprite_vertices[4] =
@@ -267,25 +674,39 @@ void r_render_sprite_ex(tex_t tex, float x, float y, float r_deg, float rox, flo
 		{-0.5f, -0.5f, 0.0f, tex.u1, tex.v2, color },
 	};
 
-	uint16_t sprite_indices[6] =
-	{
-		0, 1, 2, // TODO resolve dat shit with ccw vs cw
-		0, 2, 3,
-	};
+	rv_transform(sprite_vertices, 4, world.e);
+	memcpy(out, sprite_vertices, sizeof(sprite_vertices));
+}
 
-	uint64_t state = BGFX_STATE_DEFAULT_2D;
+void r_sprite_vertices(vrtx_t out[4], tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, float r, float g, float b, float a, bool pixel_perfect)
+{
+	trns2d_t world = _sprite_world(tex, x, y, r_deg, rox, roy, sx, sy, sox, soy, ox, oy, pixel_perfect);
+	_sprite_fill(out, tex, world, r, g, b, a);
+}
 
-	if(!ctx.hint_no_alpha)
-		state |= BGFX_STATE_BLEND_ALPHA;
-	ctx.hint_no_alpha = false;
+void r_render_sprite_ex(tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, float r, float g, float b, float a, bool pixel_perfect)
+{
+	uint64_t state = r_sprite_state();
 
-	r_render_transient(
-		sprite_vertices, 4,
-		sprite_indices, 6,
-		tex.tex,
-		1.0f, 1.0f, 1.0f, 1.0f,
-		state
-	);
+	trns2d_t world = _sprite_world(tex, x, y, r_deg, rox, roy, sx, sy, sox, soy, ox, oy, pixel_perfect);
+	if(r_culled(world))
+		return;
+
+	vrtx_t sprite_vertices[4];
+	_sprite_fill(sprite_vertices, tex, world, r, g, b, a);
+
+	rb_add_quads(tex.tex, sprite_vertices, 1, state);
+}
+
+static void _apply_world_and_color(vrtx_t * vbuf, uint16_t vbuf_count, float r, float g, float b, float a)
+{
+	// apply transform
+	trns2d_t world = tr_get_world2d();
+	rv_transform(vbuf, vbuf_count, world.e);
+
+	// apply color
+	if(r != 1.0f || g != 1.0f || b != 1.0f || a != 1.0f)
+		rv_modulate(vbuf, vbuf_count, r_colorf(r, g, b, a));
 }
 
 void r_render_transient(
@@ -298,38 +719,168 @@ void r_render_transient(
 	uint64_t state
 )
 {
-	// apply transform
-	trns_t world = tr_get_world();
-	for(size_t i = 0; i < vbuf_count; ++i)
-	{
-		gbVec4 out;
-		gb_mat4_mul_vec4(&out, &world, gb_vec4(vbuf[i].x, vbuf[i].y, 0.0f, 1.0f));
-		vbuf[i].x = out.x;
-		vbuf[i].y = out.y;
-	}
+	_apply_world_and_color(vbuf, vbuf_count, r, g, b, a);
+	rb_add(tex, vbuf, vbuf_count, ibuf, ibuf_count, state);
+}
 
-	// apply color
-	if(r != 1.0f || g != 1.0f || b != 1.0f || a != 1.0f)
-		for(size_t i = 0; i < vbuf_count; ++i)
-			vbuf[i].color = r_colorf_to_color(r_colorf_mul(r_color_to_colorf(vbuf[i].color), r_colorf(r, g, b, a)));
+void r_render_transient_quads(
+	vrtx_t * vbuf,
+	uint16_t quad_count,
+	bgfx_texture_handle_t tex,
+	float r, float g, float b, float a,
+	uint64_t state
+)
+{
+	_apply_world_and_color(vbuf, quad_count * 4, r, g, b, a);
+	rb_add_quads(tex, vbuf, quad_count, state);
+}
 
+void r_render_world(const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, bgfx_texture_handle_t tex, uint64_t state)
+{
 	rb_add(tex, vbuf, vbuf_count, ibuf, ibuf_count, state);
 }
 
+void r_render_world_quads(const vrtx_t * vbuf, uint16_t quad_count, bgfx_texture_handle_t tex, uint64_t state)
+{
+	rb_add_quads(tex, vbuf, quad_count, state);
+}
+
 void r_scissors(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-	r_next_viewid();
-	bgfx_set_view_scissor(ctx.viewid, x, y, w, h);
+	rb_scissor(x, y, w, h);
+	_cull_rect(x, y, w, h);
+	ctx.stats.scissor_switches++;
+}
+
+void r_program(bgfx_program_handle_t prog)
+{
+	rb_program(prog);
+}
+
+bool r_culled(trns2d_t world)
+{
+	_cull_update();
+
+	// bounds of [-0.5, 0.5] quad after transform
+	float ex = (gb_abs(world.a) + gb_abs(world.c)) * 0.5f;
+	float ey = (gb_abs(world.b) + gb_abs(world.d)) * 0.5f;
+
+	if(world.tx + ex < ctx.cull_x1 || world.tx - ex > ctx.cull_x2 || world.ty + ey < ctx.cull_y1 || world.ty - ey > ctx.cull_y2)
+	{
+		ctx.stats.culled++;
+		return true;
+	}
+	return false;
+}
+
+bool r_culled_vertices(const vrtx_t * vbuf, uint16_t vbuf_count)
+{
+	if(!vbuf_count)
+		return true;
+
+	_cull_update();
+
+	float x1 = vbuf[0].x, y1 = vbuf[0].y, x2 = vbuf[0].x, y2 = vbuf[0].y;
+	for(uint16_t i = 1; i < vbuf_count; ++i)
+	{
+		x1 = gb_min(x1, vbuf[i].x);
+		y1 = gb_min(y1, vbuf[i].y);
+		x2 = gb_max(x2, vbuf[i].x);
+		y2 = gb_max(y2, vbuf[i].y);
+	}
+
+	if(x2 < ctx.cull_x1 || x1 > ctx.cull_x2 || y2 < ctx.cull_y1 || y1 > ctx.cull_y2)
+	{
+		ctx.stats.culled++;
+		return true;
+	}
+	return false;
 }
 
 void r_scissors_clear()
 {
-	r_next_viewid();
-	bgfx_set_view_scissor(ctx.viewid, 0, 0, 0, 0);
+	r_scissors(0, 0, 0, 0);
+}
+
+void r_scissors_push(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	if(ctx.scissors_count >= R_SCISSORS_STACK)
+	{
+		ep_log("%s: scissors stack overflow\n", __func__);
+		return;
+	}
+
+	// intersect with parent
+	if(ctx.scissors_count)
+	{
+		uint16_t * p = ctx.scissors[ctx.scissors_count - 1];
+		int32_t x1 = gb_max(x, p[0]), y1 = gb_max(y, p[1]);
+		int32_t x2 = gb_min(x + w, p[0] + p[2]), y2 = gb_min(y + h, p[1] + p[3]);
+		x = (uint16_t)x1;
+		y = (uint16_t)y1;
+		w = (uint16_t)gb_max(x2 - x1, 0);
+		h = (uint16_t)gb_max(y2 - y1, 0);
+	}
+
+	// zero size disables scissors, so keep a 1 pixel one outside of screen when everything is clipped
+	if(!w || !h)
+	{
+		x = y = UINT16_MAX - 1;
+		w = h = 1;
+	}
+
+	uint16_t * s = ctx.scissors[ctx.scissors_count++];
+	s[0] = x; s[1] = y; s[2] = w; s[3] = h;
+	r_scissors(x, y, w, h);
+}
+
+void r_scissors_pop()
+{
+	if(!ctx.scissors_count)
+		return;
+
+	if(--ctx.scissors_count)
+	{
+		uint16_t * s = ctx.scissors[ctx.scissors_count - 1];
+		r_scissors(s[0], s[1], s[2], s[3]);
+	}
+	else
+		r_scissors_clear();
+}
+
+const r_stats_t * r_stats()
+{
+	return &ctx.stats_last;
+}
+
+void r_stats_hud(uint16_t x, uint16_t y)
+{
+	const r_stats_t * s = &ctx.stats_last;
+	bgfx_dbg_text_printf(x, y++, 0x0f, "draw calls %5u  tex switches %5u  scissors %3u", s->draw_calls, s->texture_switches, s->scissor_switches);
+	bgfx_dbg_text_printf(x, y++, 0x0f, "vertices   %5u  indices      %5u  culled   %5u", s->vertices, s->indices, s->culled);
+	bgfx_dbg_text_printf(x, y++, 0x0f, "flushes    %5u  explicit %u limit %u grow %u (chunks %u)", s->flushes, s->flush_explicit, s->flush_limit, s->flush_grow, s->batch_grow);
+	bgfx_dbg_text_printf(x, y++, 0x0f, "cpu ms     update %6.3f render %6.3f flush %6.3f frame %6.3f",
+		s->cpu_ms[R_PHASE_UPDATE], s->cpu_ms[R_PHASE_RENDER], s->cpu_ms[R_PHASE_FLUSH], s->cpu_ms[R_PHASE_FRAME]);
+	bgfx_dbg_text_printf(x, y++, 0x0f, "glyphs     pages %u occupancy %3.0f%% expands %u evictions %u", s->glyph_pages, s->glyph_occupancy * 100.0f, s->glyph_expands, s->glyph_evictions);
+}
+
+void _r_stats_phase(r_phase_t phase, double seconds)
+{
+	ctx.stats.cpu_ms[phase] += (float)(seconds * 1000.0);
+}
+
+void _r_stats_frame()
+{
+	rb_stats(&ctx.stats);
+	t_stats(&ctx.stats);
+	ctx.stats_last = ctx.stats;
+	memset(&ctx.stats, 0, sizeof(r_stats_t));
 }
 
 bgfx_vertex_decl_t *	r_decl()		{return &ctx.vert_decl;}
 uint8_t					r_viewid()		{return ctx.viewid;}
 bgfx_uniform_handle_t	r_s_texture()	{return ctx.s_texture;}
 bgfx_program_handle_t	r_prog()		{return ctx.prog;}
+bgfx_program_handle_t	r_prog_text()	{return ctx.prog_text;}
+bgfx_program_handle_t	r_prog_sdf()	{return ctx.prog_sdf;}
 tex_t					r_white_tex()	{return ctx.white_tex;}
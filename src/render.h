@@ -47,12 +47,21 @@ typedef struct
 #define TEX_FLAGS_NONE		0x0
 #define TEX_FLAGS_POINT		0x1 // disables filtering
 #define TEX_FLAGS_REPEAT	0x2
+#define TEX_FLAGS_NO_ATLAS	0x4 // always get own texture, use if uvs are in [0, 1] of whole image
 
 void _r_init();
 void _r_deinit();
 
 tex_t r_load(const char * filename, uint32_t flags);
-void r_free(tex_t tex);
+
+// decodes on worker threads, out is white texture until it's resolved at the start of some next frame or in r_load_wait
+// out must stay valid until then, or call r_load_cancel before it goes away
+void r_load_async(const char * filename, uint32_t flags, tex_t * out);
+void r_load_wait(); // blocks until all async loads are resolved
+bool r_load_pending(); // true while some async load isn't resolved yet
+bool r_load_cancel(tex_t * out); // result of pending load into out is dropped, false if there was none
+void r_free(tex_t tex); // white texture of pending load is ignored
+tex_t r_sub_tex(tex_t tex, float u1, float v1, float u2, float v2); // uvs relative to tex, so they work for textures from runtime atlas too
 
 void r_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, r_color_t color);
 void r_frame_end();
@@ -61,8 +70,10 @@ void r_frame_end();
 void r_pixel_perfect_map(float * x, float * y, float w, float h);
 
 void r_render_hint_no_alpha(); // TODO rethink how to push many arguments to render_sprite
+uint64_t r_sprite_state(); // state for next sprite, alpha blended unless hinted otherwise, consumes the hint
 void r_render_sprite(tex_t tex, float x, float y, float r_deg, float sx, float sy);
 void r_render_sprite_ex(tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, float r, float g, float b, float a, bool pixel_perfect);
+void r_sprite_vertices(vrtx_t out[4], tex_t tex, float x, float y, float r_deg, float rox, float roy, float sx, float sy, float sox, float soy, float ox, float oy, float r, float g, float b, float a, bool pixel_perfect); // world space quad, also sets world
 
 void r_render_transient( // submit transient buffers
 	vrtx_t * vbuf,
@@ -74,11 +85,71 @@ void r_render_transient( // submit transient buffers
 	uint64_t state
 );
 
+void r_render_transient_quads( // same as above, but every 4 vertexes are a quad in 0 1 2 0 2 3 order
+	vrtx_t * vbuf,
+	uint16_t quad_count,
+	bgfx_texture_handle_t tex,
+	float diffuse_r, float diffuse_g, float diffuse_b, float diffuse_a,
+	uint64_t state
+);
+
+// submit vertexes which are already in world space, e.g. cached ones
+void r_render_world(const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, bgfx_texture_handle_t tex, uint64_t state);
+void r_render_world_quads(const vrtx_t * vbuf, uint16_t quad_count, bgfx_texture_handle_t tex, uint64_t state);
+
+// scissors are in framebuffer pixels and apply per draw, changing them doesn't flush the batch
 void r_scissors(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 void r_scissors_clear();
+void r_scissors_push(uint16_t x, uint16_t y, uint16_t w, uint16_t h); // nested clip, intersected with the current one
+void r_scissors_pop();
+
+// program for following draws, invalid handle restores r_prog, changing it doesn't flush the batch
+void r_program(bgfx_program_handle_t prog);
+
+// true if primitive is fully outside of viewport and scissors, culled ones are counted in stats
+bool r_culled(trns2d_t world); // [-0.5, 0.5] quad transformed by world
+bool r_culled_vertices(const vrtx_t * vbuf, uint16_t vbuf_count); // world space vertexes
+
+// per frame statistics, r_stats returns the previous complete frame
+typedef enum
+{
+	R_PHASE_UPDATE,	// game_update
+	R_PHASE_RENDER,	// game_render, includes flush
+	R_PHASE_FLUSH,	// batch flushes
+	R_PHASE_FRAME,	// bgfx_frame
+	R_PHASE_COUNT
+} r_phase_t;
+
+typedef struct
+{
+	uint32_t draw_calls;
+	uint32_t vertices;			// uploaded to gpu
+	uint32_t indices;			// uploaded to gpu
+	uint32_t flushes;
+	uint32_t flush_explicit;	// frame end, static buffers, sorting change
+	uint32_t flush_limit;		// command, vertex or index limit of one flush reached
+	uint32_t flush_grow;		// batch memory was full
+	uint32_t batch_grow;		// batch memory chunks allocated
+	uint32_t scissor_switches;	// r_scissors calls
+	uint32_t texture_switches;
+	uint32_t culled;			// primitives skipped because they are outside of viewport or scissors
+	uint32_t glyph_pages;		// text atlas pages in use
+	float glyph_occupancy;		// 0..1 of text atlas pages area
+	uint32_t glyph_expands;		// text atlas pages grown, glyphs are kept
+	uint32_t glyph_evictions;	// text atlas pages reset in lru order
+	float cpu_ms[R_PHASE_COUNT];
+} r_stats_t;
+
+const r_stats_t * r_stats();
+void r_stats_hud(uint16_t x, uint16_t y); // prints stats with bgfx debug text, DBG_TEXT must be enabled
+
+void _r_stats_phase(r_phase_t phase, double seconds);
+void _r_stats_frame(); // call after bgfx_frame
 
 bgfx_vertex_decl_t *	r_decl();		// vertex declaration
 uint8_t					r_viewid();		// get current viewid
 bgfx_uniform_handle_t	r_s_texture();	// default texture sampler
 bgfx_program_handle_t	r_prog();		// default program
+bgfx_program_handle_t	r_prog_text();	// alpha from red channel, used for glyph atlases
+bgfx_program_handle_t	r_prog_sdf();	// signed distance field in red channel, used for text
 tex_t					r_white_tex();	// white texture
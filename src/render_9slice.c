@@ -1,17 +1,45 @@
 
 #include "render_9slice.h"
+#include "render_vertex.h"
 
 static float _u(tex_t tex, float u) {return u * (tex.u2 - tex.u1) + tex.u1;}
 static float _v(tex_t tex, float v) {return v * (tex.v2 - tex.v1) + tex.v1;}
 
-void r_9slice(
-	tex_t tex, tex_9slice_t slice,
-	float w, float h,
-	float x, float y,
-	float r_deg, float rox, float roy,
-	float ox, float oy,
-	float r, float g, float b, float a,
-	bool pixel_perfect)
+#define VERTEX_COUNT 16
+#define INDEX_COUNT (6 * 9)
+
+const uint16_t * r_9slice_indices()
+{
+	static uint16_t id[INDEX_COUNT];
+	static bool ready = false;
+
+	if(!ready)
+	{
+		for(uint16_t i = 0; i < 9; ++i) // we only have 9 squares with 2 triangles in each
+		{
+			uint16_t base = (i / 3) + i;
+			id[i * 6 + 0] = base + 0;
+			id[i * 6 + 1] = base + 1;
+			id[i * 6 + 2] = base + 5;
+			id[i * 6 + 3] = base + 0;
+			id[i * 6 + 4] = base + 5;
+			id[i * 6 + 5] = base + 4;
+		}
+		ready = true;
+	}
+
+	return id;
+}
+
+static trns2d_t _world(float w, float h, float x, float y, float r_deg, float rox, float roy, float ox, float oy, bool pixel_perfect)
+{
+	if(pixel_perfect)
+		r_pixel_perfect_map(&x, &y, w, h);
+	tr_set_world2d(tr2d_model_spr(x, y, r_deg, rox, roy, 1.0f, 1.0f, 0.0f, 0.0f, w, h, ox, oy));
+	return tr_get_world2d();
+}
+
+static void _fill(vrtx_t out[16], tex_t tex, tex_9slice_t slice, float w, float h, float r, float g, float b, float a, trns2d_t world)
 {
 	// 0----1---------------2----3
 	// |    |               |    |
@@ -24,8 +52,6 @@ void r_9slice(
 	// |    |               |    |
 	// 12--13--------------14---15
 
-	vrtx_t vert[16];
-
 	float arr_u[4] = {0.0f, slice.p1u, slice.p2u, 1.0f};
 	float arr_v[4] = {0.0f, slice.p1v, slice.p2v, 1.0f};
 
@@ -42,31 +68,48 @@ void r_9slice(
 	float arr_x[4] = {-w / 2.0f, -w / 2.0f + lw * k,  w / 2.0f - rw * k,  w / 2.0f};
 	float arr_y[4] = { h / 2.0f,  h / 2.0f - th * k, -h / 2.0f + bh * k, -h / 2.0f};
 
-	for(uint16_t i = 0; i < 16; ++i)
+	r_color_t color = r_color(r, g, b, a);
+
+	for(uint16_t i = 0; i < VERTEX_COUNT; ++i)
 	{
-		vert[i].x = arr_x[i % 4] / w;
-		vert[i].y = arr_y[i / 4] / h;
-		vert[i].z = 0.0f;
-		vert[i].u = _u(tex, arr_u[i % 4]);
-		vert[i].v = _v(tex, arr_v[i / 4]);
-		vert[i].color = 0xffffffff;
+		out[i].x = arr_x[i % 4] / w;
+		out[i].y = arr_y[i / 4] / h;
+		out[i].z = 0.0f;
+		out[i].u = _u(tex, arr_u[i % 4]);
+		out[i].v = _v(tex, arr_v[i / 4]);
+		out[i].color = color;
 	}
 
-	uint16_t id[6 * 9];
+	rv_transform(out, VERTEX_COUNT, world.e);
+}
 
-	for(uint16_t i = 0; i < 9; ++i) // we only have 9 squares with 2 triangles in each
-	{
-		uint16_t base = (i / 3) + i;
-		id[i * 6 + 0] = base + 0;
-		id[i * 6 + 1] = base + 1;
-		id[i * 6 + 2] = base + 5;
-		id[i * 6 + 3] = base + 0;
-		id[i * 6 + 4] = base + 5;
-		id[i * 6 + 5] = base + 4;
-	}
+void r_9slice_vertices(
+	vrtx_t out[16],
+	tex_t tex, tex_9slice_t slice,
+	float w, float h,
+	float x, float y,
+	float r_deg, float rox, float roy,
+	float ox, float oy,
+	float r, float g, float b, float a,
+	bool pixel_perfect)
+{
+	_fill(out, tex, slice, w, h, r, g, b, a, _world(w, h, x, y, r_deg, rox, roy, ox, oy, pixel_perfect));
+}
 
-	if(pixel_perfect)
-		r_pixel_perfect_map(&x, &y, w, h);
-	tr_set_world(tr_model_spr(x, y, r_deg, rox, roy, 1.0f, 1.0f, 0.0f, 0.0f, w, h, ox, oy));
-	r_render_transient(vert, 16, id, 6 * 9, tex.tex, r, g, b, a, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+void r_9slice(
+	tex_t tex, tex_9slice_t slice,
+	float w, float h,
+	float x, float y,
+	float r_deg, float rox, float roy,
+	float ox, float oy,
+	float r, float g, float b, float a,
+	bool pixel_perfect)
+{
+	trns2d_t world = _world(w, h, x, y, r_deg, rox, roy, ox, oy, pixel_perfect);
+	if(r_culled(world))
+		return;
+
+	vrtx_t vert[VERTEX_COUNT];
+	_fill(vert, tex, slice, w, h, r, g, b, a, world);
+	r_render_world(vert, VERTEX_COUNT, r_9slice_indices(), INDEX_COUNT, tex.tex, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
 }
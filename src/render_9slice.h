@@ -26,3 +26,14 @@ void r_9slice(tex_t tex, tex_9slice_t slice,
 	float ox, float oy,
 	float r, float g, float b, float a,
 	bool pixel_perfect);
+
+// same as above but only fills world space vertexes, use r_9slice_indices to render them
+void r_9slice_vertices(vrtx_t out[16],
+	tex_t tex, tex_9slice_t slice,
+	float w, float h,
+	float x, float y,
+	float r_deg, float rox, float roy,
+	float ox, float oy,
+	float r, float g, float b, float a,
+	bool pixel_perfect);
+const uint16_t * r_9slice_indices(); // 6 * 9 indexes
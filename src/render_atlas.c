@@ -0,0 +1,225 @@
+#include "render_atlas.h"
+#include "render_soft.h"
+#include "profiler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stb_rect_pack.h>
+
+#ifndef RA_PAGE_SIZE
+#define RA_PAGE_SIZE (1024) // 4mb of rgba8 per page plus the same again for R_SOFT mirror, pages are per filter mode
+#endif
+
+#ifndef RA_MAX_PAGES
+#define RA_MAX_PAGES (8)
+#endif
+
+#ifndef RA_MAX_IMAGE
+#define RA_MAX_IMAGE (256) // bigger images get their own texture
+#endif
+
+#define RA_PADDING (1) // edge pixels are extruded into padding so linear filtering doesn't bleed neighbours
+#define RA_MAX_FREE (256) // released slots per page waiting for reuse
+
+typedef struct
+{
+	uint16_t x, y, w, h;
+} ra_rect_t;
+
+typedef struct
+{
+	bgfx_texture_handle_t tex;
+	uint32_t flags; // only TEX_FLAGS_POINT matters
+
+	stbrp_context packer;
+	stbrp_node nodes[RA_PAGE_SIZE];
+
+	// skyline packer can't release space, so freed slots are reused as a whole
+	ra_rect_t free[RA_MAX_FREE];
+	uint16_t free_count;
+
+	ra_rect_t * used;
+	uint32_t used_count;
+	uint32_t used_cap;
+} ra_page_t;
+
+static struct
+{
+	ra_page_t * pages[RA_MAX_PAGES];
+} ctx = {0};
+
+static ra_page_t * _page_create(uint32_t flags)
+{
+	ra_page_t * page = (ra_page_t*)calloc(1, sizeof(ra_page_t));
+	page->flags = flags & TEX_FLAGS_POINT;
+	uint32_t tex_flags = BGFX_TEXTURE_NONE
+			| BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP
+			| (page->flags & TEX_FLAGS_POINT ? (BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIN_POINT) : 0);
+	page->tex = bgfx_create_texture_2d(RA_PAGE_SIZE, RA_PAGE_SIZE, false, 1, BGFX_TEXTURE_FORMAT_RGBA8, tex_flags, NULL);
+	rs_texture(page->tex, RA_PAGE_SIZE, RA_PAGE_SIZE, BGFX_TEXTURE_FORMAT_RGBA8, tex_flags, NULL);
+	stbrp_init_target(&page->packer, RA_PAGE_SIZE, RA_PAGE_SIZE, page->nodes, RA_PAGE_SIZE);
+	return page;
+}
+
+static void _page_destroy(ra_page_t * page)
+{
+	rs_texture_free(page->tex);
+	bgfx_destroy_texture(page->tex);
+	free(page->used);
+	free(page);
+}
+
+static bool _page_alloc(ra_page_t * page, uint16_t w, uint16_t h, ra_rect_t * out)
+{
+	// best fit from released slots first
+	int32_t best = -1;
+	for(uint16_t i = 0; i < page->free_count; ++i)
+		if(page->free[i].w >= w && page->free[i].h >= h && (best < 0 || page->free[i].w * page->free[i].h < page->free[best].w * page->free[best].h))
+			best = i;
+
+	if(best >= 0)
+	{
+		*out = page->free[best];
+		page->free[best] = page->free[--page->free_count];
+	}
+	else
+	{
+		stbrp_rect r = {0};
+		r.w = w;
+		r.h = h;
+		stbrp_pack_rects(&page->packer, &r, 1);
+		if(!r.was_packed)
+			return false;
+
+		out->x = r.x;
+		out->y = r.y;
+		out->w = w;
+		out->h = h;
+	}
+
+	if(page->used_count >= page->used_cap)
+	{
+		page->used_cap = page->used_cap ? page->used_cap * 2 : 64;
+		page->used = (ra_rect_t*)realloc(page->used, page->used_cap * sizeof(ra_rect_t));
+	}
+	page->used[page->used_count++] = *out;
+	return true;
+}
+
+static void _upload(ra_page_t * page, ra_rect_t slot, const uint8_t * rgba, uint16_t w, uint16_t h)
+{
+	PF_BEGIN("ra_upload");
+	uint16_t pw = w + RA_PADDING * 2;
+	uint16_t ph = h + RA_PADDING * 2;
+
+	const bgfx_memory_t * mem = bgfx_alloc(pw * ph * 4);
+	uint32_t * dst = (uint32_t*)mem->data;
+	const uint32_t * src = (const uint32_t*)rgba;
+
+	for(uint16_t j = 0; j < ph; ++j)
+	{
+		uint16_t sj = j < RA_PADDING ? 0 : (j - RA_PADDING >= h ? h - 1 : j - RA_PADDING);
+		for(uint16_t i = 0; i < pw; ++i)
+		{
+			uint16_t si = i < RA_PADDING ? 0 : (i - RA_PADDING >= w ? w - 1 : i - RA_PADDING);
+			dst[j * pw + i] = src[sj * w + si];
+		}
+	}
+
+	rs_texture_update(page->tex, slot.x, slot.y, pw, ph, mem->data, UINT16_MAX);
+	bgfx_update_texture_2d(page->tex, 0, 0, slot.x, slot.y, pw, ph, mem, UINT16_MAX);
+	PF_END();
+}
+
+void ra_deinit()
+{
+	for(uint8_t i = 0; i < RA_MAX_PAGES; ++i)
+		if(ctx.pages[i])
+		{
+			_page_destroy(ctx.pages[i]);
+			ctx.pages[i] = NULL;
+		}
+}
+
+bool ra_add(const uint8_t * rgba, uint16_t w, uint16_t h, uint32_t flags, tex_t * out)
+{
+	if(!w || !h || w > RA_MAX_IMAGE || h > RA_MAX_IMAGE || (flags & (TEX_FLAGS_REPEAT | TEX_FLAGS_NO_ATLAS)))
+		return false;
+
+	uint16_t pw = w + RA_PADDING * 2;
+	uint16_t ph = h + RA_PADDING * 2;
+
+	ra_page_t * page = NULL;
+	ra_rect_t slot;
+
+	for(uint8_t i = 0; i < RA_MAX_PAGES && !page; ++i)
+		if(ctx.pages[i] && ctx.pages[i]->flags == (flags & TEX_FLAGS_POINT) && _page_alloc(ctx.pages[i], pw, ph, &slot))
+			page = ctx.pages[i];
+
+	for(uint8_t i = 0; i < RA_MAX_PAGES && !page; ++i)
+		if(!ctx.pages[i])
+		{
+			ctx.pages[i] = _page_create(flags);
+			if(_page_alloc(ctx.pages[i], pw, ph, &slot))
+				page = ctx.pages[i];
+		}
+
+	if(!page)
+		return false;
+
+	_upload(page, slot, rgba, w, h);
+
+	memset(out, 0, sizeof(tex_t));
+	out->tex = page->tex;
+	out->pixel_w = RA_PAGE_SIZE;
+	out->pixel_h = RA_PAGE_SIZE;
+	out->w = w;
+	out->h = h;
+	out->u1 = (float)(slot.x + RA_PADDING) / (float)RA_PAGE_SIZE;
+	out->v1 = (float)(slot.y + RA_PADDING) / (float)RA_PAGE_SIZE;
+	out->u2 = (float)(slot.x + RA_PADDING + w) / (float)RA_PAGE_SIZE;
+	out->v2 = (float)(slot.y + RA_PADDING + h) / (float)RA_PAGE_SIZE;
+	return true;
+}
+
+bool ra_free(tex_t tex)
+{
+	for(uint8_t i = 0; i < RA_MAX_PAGES; ++i)
+	{
+		ra_page_t * page = ctx.pages[i];
+		if(!page || page->tex.idx != tex.tex.idx)
+			continue;
+
+		// r_sub_tex copies point anywhere inside their slot, so match the slot containing u1 v1
+		float x = tex.u1 * RA_PAGE_SIZE;
+		float y = tex.v1 * RA_PAGE_SIZE;
+
+		for(uint32_t j = 0; j < page->used_count; ++j)
+		{
+			ra_rect_t r = page->used[j];
+			if(x < r.x || y < r.y || x >= r.x + r.w || y >= r.y + r.h)
+				continue;
+
+			if(page->free_count < RA_MAX_FREE)
+				page->free[page->free_count++] = page->used[j];
+			page->used[j] = page->used[--page->used_count];
+			break;
+		}
+
+		// nothing is referencing this page anymore, evict it so space and memory come back in one piece
+		if(!page->used_count)
+		{
+			_page_destroy(page);
+			ctx.pages[i] = NULL;
+		}
+		return true;
+	}
+	return false;
+}
+
+uint8_t ra_pages_count()
+{
+	uint8_t count = 0;
+	for(uint8_t i = 0; i < RA_MAX_PAGES; ++i)
+		count += ctx.pages[i] ? 1 : 0;
+	return count;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// runtime atlas, small textures from r_load are packed into shared pages so their sprites can be batched together
+
+#include "render.h"
+
+void ra_deinit();
+
+bool ra_add(const uint8_t * rgba, uint16_t w, uint16_t h, uint32_t flags, tex_t * out); // false if image should get it's own texture
+bool ra_free(tex_t tex); // false if texture is not from atlas
+
+uint8_t ra_pages_count();
@@ -1,5 +1,7 @@
-
 #include "render_batch.h"
+#include "render_soft.h"
+#include "profiler.h"
+#include "portable.h"
 #include <stdlib.h>
 #include <memory.h>
 
@@ -7,10 +9,20 @@
 
 #ifndef NO_BATCHING
 
+#ifndef RB_FRAMES_IN_FLIGHT
+#define RB_FRAMES_IN_FLIGHT (3) // gpu might still read memory of this many previous frames
+#endif
+
 #define MAX_CMD_COUNT (4 * 1024)
-#define MAX_V_COUNT (64 * 1024)
-#define MAX_I_COUNT (64 * 1024)
-#define MAX_BUF_COUNT (8)
+#define MAX_V_COUNT (64 * 1024) // per flush, indexes are 16 bit
+#define MAX_I_COUNT (64 * 1024) // per flush
+#define MAX_QUAD_COUNT (MAX_V_COUNT / 4)
+#define MAX_CHUNK_COUNT (16)
+#define MIN_CHUNK_V_COUNT (16 * 1024)
+#define MIN_CHUNK_I_COUNT (16 * 1024)
+#define SHRINK_FRAMES (300) // high-water mark is forgotten if it wasn't reached for this many frames
+#define MAX_STATE_COUNT (256)
+#define SORT_WINDOW (256) // how far back we check overlaps, older commands are treated as overlapping
 
 typedef struct
 {
@@ -20,129 +32,450 @@ typedef struct
 	uint32_t vc;
 	uint32_t ic;
 	uint64_t state;
+	uint64_t scissor; // packed x y w h, 0 if disabled
+	bgfx_program_handle_t prog; // invalid for default one
+	bool quads; // indexes come from static quad buffer, i and ic are unused
+
+	// used only in sorted mode
+	uint64_t key; // layer | state | texture
+	uint32_t order; // original submission order, to keep sort stable
+	float x1, y1, x2, y2; // screen space bounds
 } batch_cmd_t;
 
+// cpu copy is referenced by bgfx until gpu is done with a frame, so it's never moved or reused while in flight
 typedef struct
 {
-	vrtx_t v[MAX_V_COUNT];
-	uint16_t i[MAX_I_COUNT];
+	vrtx_t * v;
+	uint16_t * i;
+	uint32_t v_cap;
+	uint32_t i_cap;
 	uint32_t v_count;
 	uint32_t i_count;
 	bgfx_dynamic_vertex_buffer_handle_t vbuf;
 	bgfx_dynamic_index_buffer_handle_t ibuf;
-} batch_mem_t;
+} batch_chunk_t;
 
+// all memory of one frame, chunks are appended when we run out of space and merged into one later
 typedef struct
 {
-	uint32_t dip;
-	uint32_t force_flush;
-	uint32_t not_enough_buffers;
-} batch_stats_t;
+	batch_chunk_t chunks[MAX_CHUNK_COUNT];
+	uint8_t chunks_count;
+	uint8_t current_chunk;
+
+	uint32_t v_high;
+	uint32_t i_high;
+	uint32_t high_age; // frames since high-water mark was last reached
+} batch_frame_t;
 
 static struct
 {
 	batch_cmd_t cmds[MAX_CMD_COUNT];
 	size_t cmds_count;
 
-	struct
-	{
-		batch_mem_t mem[MAX_BUF_COUNT];
-	} frames[2];
-
-	uint8_t current_buffer;
+	batch_frame_t frames[RB_FRAMES_IN_FLIGHT];
 	uint8_t current_frame;
 
-	batch_stats_t stats;
+	// current flush range in current chunk
+	uint32_t flush_v;
+	uint32_t flush_i;
+
+	r_stats_t stats; // only batch counters are used
+	uint16_t last_tex; // to count texture switches
+
+	bgfx_index_buffer_handle_t quad_ibuf;
+
+	bool sorting;
+	vrtx_t * sorted_v;
+	uint16_t * sorted_i;
+	uint64_t states[MAX_STATE_COUNT][3]; // state, scissor and program
+	size_t states_count;
+
+	uint64_t scissor; // applied to following commands
+	bgfx_program_handle_t prog;
 
 } ctx = {0};
 
+static void _chunk_alloc(batch_chunk_t * chunk, uint32_t v_cap, uint32_t i_cap)
+{
+	chunk->v = (vrtx_t*)malloc(v_cap * sizeof(vrtx_t));
+	chunk->i = (uint16_t*)malloc(i_cap * sizeof(uint16_t));
+	chunk->v_cap = v_cap;
+	chunk->i_cap = i_cap;
+	chunk->v_count = 0;
+	chunk->i_count = 0;
+	chunk->vbuf = bgfx_create_dynamic_vertex_buffer(v_cap, r_decl(), BGFX_BUFFER_NONE);
+	chunk->ibuf = bgfx_create_dynamic_index_buffer(i_cap, BGFX_BUFFER_NONE);
+}
+
+static void _chunk_free(batch_chunk_t * chunk)
+{
+	bgfx_destroy_dynamic_vertex_buffer(chunk->vbuf);
+	bgfx_destroy_dynamic_index_buffer(chunk->ibuf);
+	free(chunk->v);
+	free(chunk->i);
+	memset(chunk, 0, sizeof(batch_chunk_t));
+}
+
+static void _frame_free(batch_frame_t * frame)
+{
+	for(uint8_t i = 0; i < frame->chunks_count; ++i)
+		_chunk_free(frame->chunks + i);
+	frame->chunks_count = 0;
+	frame->current_chunk = 0;
+}
+
+// called when gpu is done with this frame memory, sizes it to one chunk of a recent high-water mark
+static void _frame_reset(batch_frame_t * frame)
+{
+	uint32_t v_used = 0, i_used = 0, v_cap = 0, i_cap = 0;
+	for(uint8_t i = 0; i < frame->chunks_count; ++i)
+	{
+		v_used += frame->chunks[i].v_count;
+		i_used += frame->chunks[i].i_count;
+		v_cap += frame->chunks[i].v_cap;
+		i_cap += frame->chunks[i].i_cap;
+	}
+
+	if(v_used >= frame->v_high || i_used >= frame->i_high || frame->high_age >= SHRINK_FRAMES)
+	{
+		frame->v_high = frame->high_age >= SHRINK_FRAMES ? v_used : gb_max(v_used, frame->v_high);
+		frame->i_high = frame->high_age >= SHRINK_FRAMES ? i_used : gb_max(i_used, frame->i_high);
+		frame->high_age = 0;
+	}
+	else
+		frame->high_age++;
+
+	// a bit of headroom on top of high-water mark
+	uint32_t v_want = gb_max(frame->v_high + frame->v_high / 4, MIN_CHUNK_V_COUNT);
+	uint32_t i_want = gb_max(frame->i_high + frame->i_high / 4, MIN_CHUNK_I_COUNT);
+
+	bool fits = frame->chunks_count == 1 && v_cap >= v_want && i_cap >= i_want;
+	bool too_big = v_cap > v_want * 2 || i_cap > i_want * 2;
+
+	if(!fits || too_big)
+	{
+		_frame_free(frame);
+		_chunk_alloc(frame->chunks, v_want, i_want);
+		frame->chunks_count = 1;
+	}
+
+	for(uint8_t i = 0; i < frame->chunks_count; ++i)
+	{
+		frame->chunks[i].v_count = 0;
+		frame->chunks[i].i_count = 0;
+	}
+	frame->current_chunk = 0;
+}
+
+static batch_chunk_t * _chunk()
+{
+	batch_frame_t * frame = ctx.frames + ctx.current_frame;
+	return frame->chunks + frame->current_chunk;
+}
+
 void rb_init()
 {
-	for(size_t i = 0; i < 2; ++i)
-		for(size_t j = 0; j < MAX_BUF_COUNT; ++j)
-		{
-			batch_mem_t * mem = ctx.frames[i].mem + j;
-			mem->vbuf = bgfx_create_dynamic_vertex_buffer(MAX_V_COUNT, r_decl(), BGFX_BUFFER_NONE);
-			mem->ibuf = bgfx_create_dynamic_index_buffer(MAX_I_COUNT, BGFX_BUFFER_NONE);
-		}
+	// 0 1
+	// 3 2
+	const bgfx_memory_t * quad_mem = bgfx_alloc(MAX_QUAD_COUNT * 6 * sizeof(uint16_t));
+	uint16_t * quad_i = (uint16_t*)quad_mem->data;
+	for(size_t i = 0; i < MAX_QUAD_COUNT; ++i)
+	{
+		quad_i[i * 6 + 0] = (uint16_t)(i * 4 + 0);
+		quad_i[i * 6 + 1] = (uint16_t)(i * 4 + 1);
+		quad_i[i * 6 + 2] = (uint16_t)(i * 4 + 2);
+		quad_i[i * 6 + 3] = (uint16_t)(i * 4 + 0);
+		quad_i[i * 6 + 4] = (uint16_t)(i * 4 + 2);
+		quad_i[i * 6 + 5] = (uint16_t)(i * 4 + 3);
+	}
+	ctx.quad_ibuf = bgfx_create_index_buffer(quad_mem, BGFX_BUFFER_NONE);
+
+	for(size_t i = 0; i < RB_FRAMES_IN_FLIGHT; ++i)
+		_frame_reset(ctx.frames + i);
 }
 
 void rb_deinit()
 {
-	for(size_t i = 0; i < 2; ++i)
-		for(size_t j = 0; j < MAX_BUF_COUNT; ++j)
-		{
-			batch_mem_t * mem = ctx.frames[i].mem + j;
-			bgfx_destroy_dynamic_vertex_buffer(mem->vbuf);
-			bgfx_destroy_dynamic_index_buffer(mem->ibuf);
-		}
+	for(size_t i = 0; i < RB_FRAMES_IN_FLIGHT; ++i)
+		_frame_free(ctx.frames + i);
+	bgfx_destroy_index_buffer(ctx.quad_ibuf);
+
+	free(ctx.sorted_v);
+	free(ctx.sorted_i);
+	ctx.sorted_v = NULL;
+	ctx.sorted_i = NULL;
 }
 
 void rb_start()
 {
-//	ep_log("frame stats: %u %u %u\n", ctx.stats.dip, ctx.stats.force_flush, ctx.stats.not_enough_buffers);
-	memset(&ctx.stats, 0, sizeof(batch_stats_t));
+	ctx.last_tex = UINT16_MAX;
+	ctx.scissor = 0;
+	ctx.prog.idx = UINT16_MAX;
+
+	ctx.current_frame = (ctx.current_frame + 1) % RB_FRAMES_IN_FLIGHT;
+	_frame_reset(ctx.frames + ctx.current_frame);
+	ctx.flush_v = 0;
+	ctx.flush_i = 0;
+}
+
+static void _submit(bgfx_texture_handle_t tex, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog)
+{
+	if(scissor)
+		bgfx_set_scissor((uint16_t)scissor, (uint16_t)(scissor >> 16), (uint16_t)(scissor >> 32), (uint16_t)(scissor >> 48));
+	bgfx_set_texture(0, r_s_texture(), tex, -1);
+	bgfx_set_state(state, 0);
+	bgfx_submit(r_viewid(), prog.idx != UINT16_MAX ? prog : r_prog(), 0, false);
 
-	for(size_t i = 0; i < 2; ++i)
-		ctx.current_buffer = 0;
-	ctx.current_frame = 1 - ctx.current_frame;
+	ctx.stats.draw_calls++;
+	if(tex.idx != ctx.last_tex)
+		ctx.stats.texture_switches++;
+	ctx.last_tex = tex.idx;
 }
 
-void rb_add(bgfx_texture_handle_t tex, const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, uint64_t state)
+static void _flush(uint32_t * reason);
+
+static batch_chunk_t * _reserve(uint32_t vbuf_count, uint32_t ibuf_count)
 {
-	batch_mem_t * mem = ctx.frames[ctx.current_frame].mem + ctx.current_buffer;
+	batch_chunk_t * chunk = _chunk();
 
 	if(
 		(ctx.cmds_count >= MAX_CMD_COUNT) ||
-		(mem->v_count + ((size_t)vbuf_count) > MAX_V_COUNT) ||
-		(mem->i_count + ((size_t)ibuf_count) > MAX_I_COUNT)
+		(chunk->v_count - ctx.flush_v + vbuf_count > MAX_V_COUNT) ||
+		(chunk->i_count - ctx.flush_i + ibuf_count > MAX_I_COUNT)
 	)
+		_flush(&ctx.stats.flush_limit);
+
+	if(chunk->v_count + vbuf_count > chunk->v_cap || chunk->i_count + ibuf_count > chunk->i_cap)
 	{
-		ctx.stats.force_flush++;
-		rb_flush();
-		mem = ctx.frames[ctx.current_frame].mem + ctx.current_buffer;
+		_flush(&ctx.stats.flush_grow);
+
+		// data in current chunk is already referenced by bgfx, so continue in a new one
+		batch_frame_t * frame = ctx.frames + ctx.current_frame;
+		if(frame->current_chunk + 1 < frame->chunks_count)
+			frame->current_chunk++;
+		else if(frame->chunks_count < MAX_CHUNK_COUNT)
+		{
+			// grow geometrically, chunks are merged into one when frame memory is reused
+			uint32_t v_cap = gb_max(chunk->v_cap * 2, vbuf_count);
+			uint32_t i_cap = gb_max(chunk->i_cap * 2, ibuf_count);
+			_chunk_alloc(frame->chunks + frame->chunks_count, v_cap, i_cap);
+			frame->current_chunk = frame->chunks_count++;
+			ctx.stats.batch_grow++;
+		}
+		else
+		{
+			ep_log("%s: out of batch memory, dropping geometry\n", __func__);
+			return NULL;
+		}
+
+		chunk = _chunk();
+		ctx.flush_v = chunk->v_count;
+		ctx.flush_i = chunk->i_count;
 	}
 
-	// copy indexes with offset
-	for(size_t i = 0; i < ibuf_count; ++i)
-		mem->i[mem->i_count + i] = ibuf[i] + (uint16_t)mem->v_count;
+	return chunk;
+}
 
+static void _push_cmd(batch_chunk_t * chunk, bgfx_texture_handle_t tex, const vrtx_t * vbuf, uint32_t vbuf_count, uint32_t ibuf_count, uint64_t state, bool quads)
+{
 	// copy vertexes
-	memcpy(mem->v + mem->v_count, vbuf, vbuf_count * sizeof(vrtx_t));
+	memcpy(chunk->v + chunk->v_count, vbuf, vbuf_count * sizeof(vrtx_t));
 
 	// add command
 	batch_cmd_t * c = ctx.cmds + ctx.cmds_count;
+
+	if(ctx.sorting)
+	{
+		c->x1 = c->x2 = vbuf_count ? vbuf[0].x : 0.0f;
+		c->y1 = c->y2 = vbuf_count ? vbuf[0].y : 0.0f;
+		for(size_t i = 1; i < vbuf_count; ++i)
+		{
+			c->x1 = vbuf[i].x < c->x1 ? vbuf[i].x : c->x1;
+			c->y1 = vbuf[i].y < c->y1 ? vbuf[i].y : c->y1;
+			c->x2 = vbuf[i].x > c->x2 ? vbuf[i].x : c->x2;
+			c->y2 = vbuf[i].y > c->y2 ? vbuf[i].y : c->y2;
+		}
+	}
+
 	c->tex = tex;
 	c->state = state;
-	c->v = mem->v_count;
+	c->scissor = ctx.scissor;
+	c->prog = ctx.prog;
+	c->quads = quads;
+	c->v = chunk->v_count;
 	c->vc = vbuf_count;
-	c->i = mem->i_count;
+	c->i = chunk->i_count;
 	c->ic = ibuf_count;
 
 	// increase counters
 	ctx.cmds_count++;
-	mem->v_count += vbuf_count;
-	mem->i_count += ibuf_count;
+	chunk->v_count += vbuf_count;
+	chunk->i_count += ibuf_count;
 }
 
-void rb_flush()
+void rb_add(bgfx_texture_handle_t tex, const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, uint64_t state)
+{
+	batch_chunk_t * chunk = _reserve(vbuf_count, ibuf_count);
+	if(!chunk)
+		return;
+
+	// copy indexes with offset, they are relative to flush start
+	uint16_t offset = (uint16_t)(chunk->v_count - ctx.flush_v);
+	for(size_t i = 0; i < ibuf_count; ++i)
+		chunk->i[chunk->i_count + i] = ibuf[i] + offset;
+
+	_push_cmd(chunk, tex, vbuf, vbuf_count, ibuf_count, state, false);
+}
+
+void rb_add_quads(bgfx_texture_handle_t tex, const vrtx_t * vbuf, uint16_t quad_count, uint64_t state)
+{
+	batch_chunk_t * chunk = _reserve(quad_count * 4, 0);
+	if(!chunk)
+		return;
+
+	_push_cmd(chunk, tex, vbuf, quad_count * 4, 0, state, true);
+}
+
+void rb_add_static(bgfx_texture_handle_t tex, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, bgfx_index_buffer_handle_t ibuf, uint32_t i, uint32_t ic, uint64_t state)
 {
-	batch_mem_t * mem = ctx.frames[ctx.current_frame].mem + ctx.current_buffer;
+	rb_flush();
 
-	if(!ctx.cmds_count || !mem->v_count || !mem->i_count)
+	bgfx_set_vertex_buffer(0, vbuf, v, vc);
+	bgfx_set_index_buffer(ibuf, i, ic);
+	_submit(tex, state, ctx.scissor, ctx.prog);
+	rs_draw_static(tex, vbuf, v, vc, i, ic, state, ctx.scissor, ctx.prog);
+}
+
+void rb_sorting(bool enabled)
+{
+	if(ctx.sorting != enabled)
+		rb_flush();
+	ctx.sorting = enabled;
+
+	if(enabled && !ctx.sorted_v)
+	{
+		ctx.sorted_v = (vrtx_t*)malloc(MAX_V_COUNT * sizeof(vrtx_t));
+		ctx.sorted_i = (uint16_t*)malloc(MAX_I_COUNT * sizeof(uint16_t));
+	}
+}
+
+static bool _overlaps(const batch_cmd_t * a, const batch_cmd_t * b)
+{
+	return a->x1 < b->x2 && b->x1 < a->x2 && a->y1 < b->y2 && b->y1 < a->y2;
+}
+
+static uint64_t _state_index(uint64_t state, uint64_t scissor, bgfx_program_handle_t prog)
+{
+	for(size_t i = 0; i < ctx.states_count; ++i)
+		if(ctx.states[i][0] == state && ctx.states[i][1] == scissor && ctx.states[i][2] == prog.idx)
+			return i;
+
+	if(ctx.states_count < MAX_STATE_COUNT)
+	{
+		ctx.states[ctx.states_count][0] = state;
+		ctx.states[ctx.states_count][1] = scissor;
+		ctx.states[ctx.states_count][2] = prog.idx;
+		return ctx.states_count++;
+	}
+
+	return MAX_STATE_COUNT; // out of slots, share the last one, flush still compares full state before merging
+}
+
+static int _cmp_cmd(const void * a, const void * b)
+{
+	const batch_cmd_t * ca = (const batch_cmd_t*)a;
+	const batch_cmd_t * cb = (const batch_cmd_t*)b;
+	if(ca->key != cb->key)
+		return ca->key < cb->key ? -1 : 1;
+	return ca->order < cb->order ? -1 : (ca->order > cb->order ? 1 : 0);
+}
+
+// key is [layer:32][state, scissor and program:16][texture:16]
+// layer is the lowest one which is still above every earlier overlapping command with different state or texture,
+// so reordering never changes what ends up on screen
+static void _sort(batch_chunk_t * chunk)
+{
+	ctx.states_count = 0;
+	uint32_t floor = 0; // lowest allowed layer because of commands which fell out of the window
+
+	for(size_t i = 0; i < ctx.cmds_count; ++i)
+	{
+		batch_cmd_t * c = ctx.cmds + i;
+		uint64_t material = (_state_index(c->state, c->scissor, c->prog) << 16) | c->tex.idx;
+
+		if(i >= SORT_WINDOW)
+		{
+			uint32_t old = (uint32_t)(ctx.cmds[i - SORT_WINDOW].key >> 32) + 1;
+			floor = old > floor ? old : floor;
+		}
+
+		uint32_t layer = floor;
+		for(size_t j = i >= SORT_WINDOW ? i - SORT_WINDOW + 1 : 0; j < i; ++j)
+		{
+			batch_cmd_t * p = ctx.cmds + j;
+			if(!_overlaps(c, p))
+				continue;
+
+			uint32_t p_layer = (uint32_t)(p->key >> 32);
+			uint32_t need = ((p->key & 0xffffffff) == material) ? p_layer : p_layer + 1;
+			layer = need > layer ? need : layer;
+		}
+
+		c->key = ((uint64_t)layer << 32) | material;
+		c->order = (uint32_t)i;
+	}
+
+	qsort(ctx.cmds, ctx.cmds_count, sizeof(batch_cmd_t), _cmp_cmd);
+
+	// reorder vertexes and indexes so merged commands are continuous
+	uint32_t v_offset = 0;
+	uint32_t i_offset = 0;
+	for(size_t i = 0; i < ctx.cmds_count; ++i)
+	{
+		batch_cmd_t * c = ctx.cmds + i;
+		memcpy(ctx.sorted_v + v_offset, chunk->v + c->v, c->vc * sizeof(vrtx_t));
+		for(size_t j = 0; j < c->ic; ++j)
+			ctx.sorted_i[i_offset + j] = chunk->i[c->i + j] - (uint16_t)(c->v - ctx.flush_v) + (uint16_t)v_offset;
+		c->v = ctx.flush_v + v_offset;
+		c->i = ctx.flush_i + i_offset;
+		v_offset += c->vc;
+		i_offset += c->ic;
+	}
+	memcpy(chunk->v + ctx.flush_v, ctx.sorted_v, v_offset * sizeof(vrtx_t));
+	memcpy(chunk->i + ctx.flush_i, ctx.sorted_i, i_offset * sizeof(uint16_t));
+}
+
+static void _flush(uint32_t * reason)
+{
+	batch_chunk_t * chunk = _chunk();
+	uint32_t v_count = chunk->v_count - ctx.flush_v;
+	uint32_t i_count = chunk->i_count - ctx.flush_i;
+
+	if(!ctx.cmds_count || !v_count)
 	{
 		ctx.cmds_count = 0;
-		mem->v_count = 0;
-		mem->i_count = 0;
 		return;
 	}
 
-	// update buffers for a whole batch
-	bgfx_update_dynamic_vertex_buffer(mem->vbuf, 0, bgfx_make_ref(mem->v, (uint32_t)mem->v_count * sizeof(vrtx_t)));
-	bgfx_update_dynamic_index_buffer(mem->ibuf, 0, bgfx_make_ref(mem->i, (uint32_t)mem->i_count * sizeof(uint16_t)));
+	PF_BEGIN("rb_flush");
+	double time = hp_time();
+	ctx.stats.flushes++;
+	(*reason)++;
+	ctx.stats.vertices += v_count;
+	ctx.stats.indices += i_count;
+
+	if(ctx.sorting)
+		_sort(chunk);
+
+	// update buffers for a whole batch, only the range of this flush
+	bgfx_update_dynamic_vertex_buffer(chunk->vbuf, ctx.flush_v, bgfx_make_ref(chunk->v + ctx.flush_v, v_count * sizeof(vrtx_t)));
+	if(i_count)
+		bgfx_update_dynamic_index_buffer(chunk->ibuf, ctx.flush_i, bgfx_make_ref(chunk->i + ctx.flush_i, i_count * sizeof(uint16_t)));
 
 	// exec cmds
 	bool batch = false;
+	uint32_t batch_v_start = 0;
+	uint32_t batch_v_size = 0;
 	uint32_t batch_i_start = 0;
 	uint32_t batch_i_size = 0;
 
@@ -150,54 +483,148 @@ void rb_flush()
 	{
 		batch_cmd_t * c = ctx.cmds + i;
 		batch_cmd_t * cn = (i + 1 < ctx.cmds_count) ? ctx.cmds + i + 1 : NULL;
-		bool can_batch_with_next = cn && (c->state == cn->state) && (c->tex.idx == cn->tex.idx);
+		bool can_batch_with_next = cn && (c->state == cn->state) && (c->scissor == cn->scissor) && (c->prog.idx == cn->prog.idx) && (c->tex.idx == cn->tex.idx) && (c->quads == cn->quads);
+
+		// quads are drawn from static index buffer with vertex offset, so they must be continuous in memory
+		if(can_batch_with_next && c->quads)
+			can_batch_with_next = (cn->v == c->v + c->vc);
 
 		// if no batch, push current one to it
 		if(!batch)
 		{
 			batch = true;
+			batch_v_start = c->v;
+			batch_v_size = 0;
 			batch_i_start = c->i;
 			batch_i_size = 0;
 		}
 
+		batch_v_size += c->vc;
 		batch_i_size += c->ic;
 
 		if(!can_batch_with_next)
 		{
-			bgfx_set_dynamic_vertex_buffer(0, mem->vbuf, 0, mem->v_count);
-			bgfx_set_dynamic_index_buffer(mem->ibuf, batch_i_start, batch_i_size);
-			bgfx_set_texture(0, r_s_texture(), c->tex, -1);
-			bgfx_set_state(c->state, 0);
-			bgfx_submit(r_viewid(), r_prog(), 0, false);
-
-			ctx.stats.dip++;
+			if(c->quads)
+			{
+				bgfx_set_dynamic_vertex_buffer(0, chunk->vbuf, batch_v_start, batch_v_size);
+				bgfx_set_index_buffer(ctx.quad_ibuf, 0, batch_v_size / 4 * 6);
+				rs_draw(c->tex, chunk->v + batch_v_start, batch_v_size, NULL, 0, c->state, c->scissor, c->prog);
+			}
+			else
+			{
+				// indexes are relative to flush start
+				bgfx_set_dynamic_vertex_buffer(0, chunk->vbuf, ctx.flush_v, v_count);
+				bgfx_set_dynamic_index_buffer(chunk->ibuf, batch_i_start, batch_i_size);
+				rs_draw(c->tex, chunk->v + ctx.flush_v, v_count, chunk->i + batch_i_start, batch_i_size, c->state, c->scissor, c->prog);
+			}
+			_submit(c->tex, c->state, c->scissor, c->prog);
 			batch = false;
 		}
 	}
 
-	// clear
+	// clear, next flush continues in the same chunk right after this one
 	ctx.cmds_count = 0;
-	mem->v_count = 0;
-	mem->i_count = 0;
+	ctx.flush_v = chunk->v_count;
+	ctx.flush_i = chunk->i_count;
 
-	// move to next buffer
-	ctx.current_buffer++;
+	ctx.stats.cpu_ms[R_PHASE_FLUSH] += (float)((hp_time() - time) * 1000.0);
+	PF_END();
+}
 
-	// cycle back to a first buffer if needed
-	if(ctx.current_buffer >= MAX_BUF_COUNT)
-	{
-		ep_log("%s: NOT ENOUGH BUFFERS", __func__);
-		ctx.stats.not_enough_buffers++;
-		ctx.current_buffer = 0;
-	}
+void rb_flush()
+{
+	_flush(&ctx.stats.flush_explicit);
+}
+
+void rb_scissor(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	ctx.scissor = (w && h) ? ((uint64_t)x | ((uint64_t)y << 16) | ((uint64_t)w << 32) | ((uint64_t)h << 48)) : 0;
+}
+
+void rb_program(bgfx_program_handle_t prog)
+{
+	ctx.prog = prog;
+}
+
+void rb_stats(r_stats_t * stats)
+{
+	stats->draw_calls += ctx.stats.draw_calls;
+	stats->vertices += ctx.stats.vertices;
+	stats->indices += ctx.stats.indices;
+	stats->flushes += ctx.stats.flushes;
+	stats->flush_explicit += ctx.stats.flush_explicit;
+	stats->flush_limit += ctx.stats.flush_limit;
+	stats->flush_grow += ctx.stats.flush_grow;
+	stats->batch_grow += ctx.stats.batch_grow;
+	stats->texture_switches += ctx.stats.texture_switches;
+	stats->cpu_ms[R_PHASE_FLUSH] += ctx.stats.cpu_ms[R_PHASE_FLUSH];
+	memset(&ctx.stats, 0, sizeof(r_stats_t));
 }
 
 #else
 
+static struct
+{
+	r_stats_t stats;
+	uint16_t last_tex;
+	uint16_t scissor[4];
+	bgfx_program_handle_t prog;
+} ctx = {0};
+
 void rb_init() {}
 void rb_deinit() {}
-void rb_start() {}
+void rb_start() {ctx.last_tex = UINT16_MAX; memset(ctx.scissor, 0, sizeof(ctx.scissor)); ctx.prog.idx = UINT16_MAX;}
 void rb_flush() {}
+void rb_sorting(bool enabled) {}
+
+void rb_scissor(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	ctx.scissor[0] = x;
+	ctx.scissor[1] = y;
+	ctx.scissor[2] = w;
+	ctx.scissor[3] = h;
+}
+
+void rb_program(bgfx_program_handle_t prog)
+{
+	ctx.prog = prog;
+}
+
+static uint64_t _scissor()
+{
+	return (ctx.scissor[2] && ctx.scissor[3]) ? ((uint64_t)ctx.scissor[0] | ((uint64_t)ctx.scissor[1] << 16) | ((uint64_t)ctx.scissor[2] << 32) | ((uint64_t)ctx.scissor[3] << 48)) : 0;
+}
+
+static void _submit(bgfx_texture_handle_t texture, uint64_t state)
+{
+	if(ctx.scissor[2] && ctx.scissor[3])
+		bgfx_set_scissor(ctx.scissor[0], ctx.scissor[1], ctx.scissor[2], ctx.scissor[3]);
+	bgfx_set_texture(0, r_s_texture(), texture, -1);
+	bgfx_set_state(state, 0);
+	bgfx_submit(r_viewid(), ctx.prog.idx != UINT16_MAX ? ctx.prog : r_prog(), 0, false);
+
+	ctx.stats.draw_calls++;
+	if(texture.idx != ctx.last_tex)
+		ctx.stats.texture_switches++;
+	ctx.last_tex = texture.idx;
+}
+
+void rb_stats(r_stats_t * stats)
+{
+	stats->draw_calls += ctx.stats.draw_calls;
+	stats->vertices += ctx.stats.vertices;
+	stats->indices += ctx.stats.indices;
+	stats->texture_switches += ctx.stats.texture_switches;
+	memset(&ctx.stats, 0, sizeof(r_stats_t));
+}
+
+void rb_add_static(bgfx_texture_handle_t texture, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, bgfx_index_buffer_handle_t ibuf, uint32_t i, uint32_t ic, uint64_t state)
+{
+	bgfx_set_vertex_buffer(0, vbuf, v, vc);
+	bgfx_set_index_buffer(ibuf, i, ic);
+	_submit(texture, state);
+	rs_draw_static(texture, vbuf, v, vc, i, ic, state, _scissor(), ctx.prog);
+}
 
 void rb_add(bgfx_texture_handle_t texture, const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, uint64_t state)
 {
@@ -209,9 +636,26 @@ void rb_add(bgfx_texture_handle_t texture, const vrtx_t * vbuf, uint16_t vbuf_co
 
 	bgfx_set_transient_vertex_buffer(0, &vb, 0, vbuf_count);
 	bgfx_set_transient_index_buffer(&ib, 0, ibuf_count);
-	bgfx_set_texture(0, r_s_texture(), texture, -1);
-	bgfx_set_state(state, 0);
-	bgfx_submit(r_viewid(), r_prog(), 0, false);
+	_submit(texture, state);
+	rs_draw(texture, vbuf, vbuf_count, ibuf, ibuf_count, state, _scissor(), ctx.prog);
+
+	ctx.stats.vertices += vbuf_count;
+	ctx.stats.indices += ibuf_count;
+}
+
+void rb_add_quads(bgfx_texture_handle_t texture, const vrtx_t * vbuf, uint16_t quad_count, uint64_t state)
+{
+	uint16_t * ibuf = (uint16_t*)alloca(quad_count * 6 * sizeof(uint16_t));
+	for(uint16_t i = 0; i < quad_count; ++i)
+	{
+		ibuf[i * 6 + 0] = i * 4 + 0;
+		ibuf[i * 6 + 1] = i * 4 + 1;
+		ibuf[i * 6 + 2] = i * 4 + 2;
+		ibuf[i * 6 + 3] = i * 4 + 0;
+		ibuf[i * 6 + 4] = i * 4 + 2;
+		ibuf[i * 6 + 5] = i * 4 + 3;
+	}
+	rb_add(texture, vbuf, quad_count * 4, ibuf, quad_count * 6, state);
 }
 
 #endif
@@ -7,4 +7,21 @@ void rb_deinit();
 
 void rb_start();
 void rb_add(bgfx_texture_handle_t texture, const vrtx_t * vbuf, uint16_t vbuf_count, const uint16_t * ibuf, uint32_t ibuf_count, uint64_t state);
+void rb_add_quads(bgfx_texture_handle_t texture, const vrtx_t * vbuf, uint16_t quad_count, uint64_t state); // 4 vertexes per quad, 0 1 2 0 2 3 topology
 void rb_flush();
+
+// scissor rect in framebuffer pixels for following commands, zero size disables it
+// commands with different scissors are not merged, but no flush or view switch is needed
+void rb_scissor(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+// program for following commands, invalid handle means r_prog, same merging rules as scissor
+void rb_program(bgfx_program_handle_t prog);
+
+// adds batch counters gathered since previous call to stats and resets them
+void rb_stats(r_stats_t * stats);
+
+// submits a range of persistent buffers, pending commands are flushed first to keep the order
+void rb_add_static(bgfx_texture_handle_t texture, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, bgfx_index_buffer_handle_t ibuf, uint32_t i, uint32_t ic, uint64_t state);
+
+// if enabled, commands which don't overlap on screen are reordered by state and texture before merging
+void rb_sorting(bool enabled);
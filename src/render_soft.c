@@ -0,0 +1,673 @@
+#include "render_soft.h"
+#include "transforms.h"
+#include "filesystem.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef R_SOFT
+
+#ifndef RS_MAX_TEXTURES
+#define RS_MAX_TEXTURES (4096) // same as bgfx handle limits
+#endif
+
+#ifndef RS_MAX_BUFFERS
+#define RS_MAX_BUFFERS (4096)
+#endif
+
+#define RS_MAX_PENDING_FREE (256)
+
+typedef struct
+{
+	uint16_t w, h;
+	uint8_t bpp; // 1 for R8, 4 for RGBA8
+	bool bgra; // swizzled to RGBA8 on upload
+	uint32_t flags; // bgfx texture flags, only wrap and point sampling matter
+	uint8_t * data; // NULL if format can't be decoded
+} rs_tex_t;
+
+typedef struct
+{
+	vrtx_t * v;
+	uint16_t * i;
+	uint32_t vc;
+	uint32_t ic;
+} rs_buffer_t;
+
+typedef struct
+{
+	float x, y;
+	float a[6]; // u v r g b a
+} rs_vert_t;
+
+typedef enum
+{
+	RS_SHADER_TEX_COLOR,
+	RS_SHADER_TEXT,
+	RS_SHADER_SDF,
+} rs_shader_t;
+
+// recorded draw or clear, vertexes are already in framebuffer space
+typedef struct
+{
+	uint16_t tex;
+	uint64_t state;
+	rs_shader_t shader;
+	int32_t clip[4]; // x1 y1 x2 y2, exclusive
+	uint32_t first; // in verts
+	uint32_t count; // triangles, 0 means clear of clip rect
+	uint8_t clear[4];
+} rs_cmd_t;
+
+static struct
+{
+	uint8_t * fb;
+	uint16_t fb_w, fb_h;
+	int32_t view[4]; // x1 y1 x2 y2, exclusive
+	trns_t m; // world to framebuffer pixels
+
+	rs_tex_t * tex[RS_MAX_TEXTURES];
+	rs_buffer_t * buffers[RS_MAX_BUFFERS];
+
+	rs_cmd_t * cmds;
+	uint32_t cmds_count;
+	uint32_t cmds_cap;
+	rs_vert_t * verts;
+	uint32_t verts_count;
+	uint32_t verts_cap;
+	uint16_t pending_free[RS_MAX_PENDING_FREE];
+	uint16_t pending_free_count;
+} ctx = {0};
+
+static void _tex_free(uint16_t idx)
+{
+	if(!ctx.tex[idx])
+		return;
+	free(ctx.tex[idx]->data);
+	free(ctx.tex[idx]);
+	ctx.tex[idx] = NULL;
+}
+
+static rs_cmd_t * _cmd()
+{
+	if(ctx.cmds_count >= ctx.cmds_cap)
+	{
+		ctx.cmds_cap = ctx.cmds_cap ? ctx.cmds_cap * 2 : 256;
+		ctx.cmds = (rs_cmd_t*)realloc(ctx.cmds, ctx.cmds_cap * sizeof(rs_cmd_t));
+	}
+	rs_cmd_t * c = ctx.cmds + ctx.cmds_count++;
+	memset(c, 0, sizeof(rs_cmd_t));
+	memcpy(c->clip, ctx.view, sizeof(c->clip));
+	c->first = ctx.verts_count;
+	return c;
+}
+
+static rs_vert_t * _verts(uint32_t count)
+{
+	if(ctx.verts_count + count > ctx.verts_cap)
+	{
+		while(ctx.verts_count + count > ctx.verts_cap)
+			ctx.verts_cap = ctx.verts_cap ? ctx.verts_cap * 2 : 4096;
+		ctx.verts = (rs_vert_t*)realloc(ctx.verts, ctx.verts_cap * sizeof(rs_vert_t));
+	}
+	rs_vert_t * v = ctx.verts + ctx.verts_count;
+	ctx.verts_count += count;
+	return v;
+}
+
+void rs_deinit()
+{
+	for(uint32_t i = 0; i < RS_MAX_TEXTURES; ++i)
+		_tex_free(i);
+	for(uint32_t i = 0; i < RS_MAX_BUFFERS; ++i)
+		if(ctx.buffers[i])
+		{
+			free(ctx.buffers[i]->v);
+			free(ctx.buffers[i]->i);
+			free(ctx.buffers[i]);
+		}
+	free(ctx.fb);
+	free(ctx.cmds);
+	free(ctx.verts);
+	memset(&ctx, 0, sizeof(ctx));
+}
+
+void rs_resize(uint16_t w, uint16_t h)
+{
+	if(w == ctx.fb_w && h == ctx.fb_h)
+		return;
+	free(ctx.fb);
+	ctx.fb = (uint8_t*)calloc((size_t)w * h, 4);
+	ctx.fb_w = w;
+	ctx.fb_h = h;
+}
+
+// -----------------------------------------------------------------------------
+// textures
+
+void rs_texture(bgfx_texture_handle_t tex, uint16_t w, uint16_t h, bgfx_texture_format_t format, uint32_t flags, const void * data)
+{
+	if(tex.idx >= RS_MAX_TEXTURES)
+		return;
+	_tex_free(tex.idx);
+
+	rs_tex_t * t = (rs_tex_t*)calloc(1, sizeof(rs_tex_t));
+	t->w = w;
+	t->h = h;
+	t->flags = flags;
+	ctx.tex[tex.idx] = t;
+
+	if(format == BGFX_TEXTURE_FORMAT_R8)
+		t->bpp = 1;
+	else if(format == BGFX_TEXTURE_FORMAT_RGBA8 || format == BGFX_TEXTURE_FORMAT_BGRA8)
+		t->bpp = 4;
+	else
+		return;
+
+	t->bgra = format == BGFX_TEXTURE_FORMAT_BGRA8;
+	t->data = (uint8_t*)calloc((size_t)w * h, t->bpp);
+	if(data)
+		rs_texture_update(tex, 0, 0, w, h, data, UINT16_MAX);
+}
+
+void rs_texture_ktx(bgfx_texture_handle_t tex, const void * data, uint32_t size, uint32_t flags)
+{
+	// 12 bytes identifier and 13 uint32 fields, then key values and first mip
+	const uint8_t * d = (const uint8_t*)data;
+	uint32_t h[13];
+	if(size < 64 + 4)
+	{
+		rs_texture(tex, 1, 1, BGFX_TEXTURE_FORMAT_UNKNOWN, flags, NULL);
+		return;
+	}
+	memcpy(h, d + 12, sizeof(h));
+
+	uint32_t gl_type = h[1], gl_format = h[3], gl_internal = h[4], w = h[6], hh = h[7], kv = h[12];
+	bool rgba8 = gl_internal == 0x8058 || (gl_format == 0x1908 && gl_type == 0x1401); // GL_RGBA8 or GL_RGBA + GL_UNSIGNED_BYTE
+
+	// kv and image size come from file, so sums are done in 64 bits
+	uint32_t image_size = 0;
+	if(64 + (uint64_t)kv + 4 <= size)
+		memcpy(&image_size, d + 64 + kv, 4);
+
+	if(!rgba8 || h[0] != 0x04030201 || !w || !hh || w > UINT16_MAX || hh > UINT16_MAX || image_size < (uint64_t)w * hh * 4 || 64 + (uint64_t)kv + 4 + image_size > size)
+	{
+		rs_texture(tex, (uint16_t)(w ? w : 1), (uint16_t)(hh ? hh : 1), BGFX_TEXTURE_FORMAT_UNKNOWN, flags, NULL);
+		return;
+	}
+
+	rs_texture(tex, (uint16_t)w, (uint16_t)hh, BGFX_TEXTURE_FORMAT_RGBA8, flags, d + 64 + kv + 4);
+}
+
+void rs_texture_update(bgfx_texture_handle_t tex, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const void * data, uint16_t pitch)
+{
+	rs_tex_t * t = tex.idx < RS_MAX_TEXTURES ? ctx.tex[tex.idx] : NULL;
+	if(!t || !t->data || x + w > t->w || y + h > t->h)
+		return;
+
+	uint8_t bpp = t->bpp;
+	uint32_t stride = pitch == UINT16_MAX ? w * bpp : pitch;
+	const uint8_t * src = (const uint8_t*)data;
+	for(uint16_t j = 0; j < h; ++j)
+	{
+		uint8_t * dst = t->data + ((size_t)(y + j) * t->w + x) * bpp;
+		memcpy(dst, src + j * stride, w * bpp);
+		if(t->bgra)
+			for(uint16_t i = 0; i < w; ++i)
+			{
+				uint8_t b = dst[i * 4 + 0];
+				dst[i * 4 + 0] = dst[i * 4 + 2];
+				dst[i * 4 + 2] = b;
+			}
+	}
+}
+
+void rs_texture_free(bgfx_texture_handle_t tex)
+{
+	if(tex.idx >= RS_MAX_TEXTURES || !ctx.tex[tex.idx])
+		return;
+
+	// draws of this frame might still use it, bgfx doesn't reuse the handle until next frame either
+	if(ctx.pending_free_count < RS_MAX_PENDING_FREE)
+		ctx.pending_free[ctx.pending_free_count++] = tex.idx;
+	else
+		_tex_free(tex.idx);
+}
+
+// -----------------------------------------------------------------------------
+// static buffers
+
+void rs_static(bgfx_vertex_buffer_handle_t vbuf, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic)
+{
+	if(vbuf.idx >= RS_MAX_BUFFERS)
+		return;
+	rs_static_free(vbuf);
+
+	rs_buffer_t * b = (rs_buffer_t*)calloc(1, sizeof(rs_buffer_t));
+	b->v = (vrtx_t*)malloc(vc * sizeof(vrtx_t));
+	b->i = (uint16_t*)malloc(ic * sizeof(uint16_t));
+	memcpy(b->v, v, vc * sizeof(vrtx_t));
+	memcpy(b->i, i, ic * sizeof(uint16_t));
+	b->vc = vc;
+	b->ic = ic;
+	ctx.buffers[vbuf.idx] = b;
+}
+
+void rs_static_free(bgfx_vertex_buffer_handle_t vbuf)
+{
+	if(vbuf.idx >= RS_MAX_BUFFERS || !ctx.buffers[vbuf.idx])
+		return;
+	free(ctx.buffers[vbuf.idx]->v);
+	free(ctx.buffers[vbuf.idx]->i);
+	free(ctx.buffers[vbuf.idx]);
+	ctx.buffers[vbuf.idx] = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// view
+
+void rs_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool clear, uint32_t rgba)
+{
+	ctx.view[0] = gb_min(x, ctx.fb_w);
+	ctx.view[1] = gb_min(y, ctx.fb_h);
+	ctx.view[2] = gb_min(x + w, ctx.fb_w);
+	ctx.view[3] = gb_min(y + h, ctx.fb_h);
+
+	// vpv is relative to viewport origin
+	trns_t offset;
+	gb_mat4_translate(&offset, gb_vec3((float)x, (float)y, 0.0f));
+	ctx.m = tr_mul(offset, tr_get_vpv());
+
+	if(!clear)
+		return;
+
+	rs_cmd_t * c = _cmd();
+	c->clear[0] = (uint8_t)(rgba >> 24);
+	c->clear[1] = (uint8_t)(rgba >> 16);
+	c->clear[2] = (uint8_t)(rgba >> 8);
+	c->clear[3] = (uint8_t)rgba;
+}
+
+// -----------------------------------------------------------------------------
+// sampling
+
+static int32_t _wrap(int32_t i, int32_t n, uint32_t mode)
+{
+	switch(mode)
+	{
+	case 0: // repeat
+		i %= n;
+		return i < 0 ? i + n : i;
+	case 1: // mirror
+		i = i < 0 ? -i - 1 : i;
+		i %= 2 * n;
+		return i < n ? i : 2 * n - 1 - i;
+	default: // clamp, border is treated as clamp
+		return i < 0 ? 0 : (i >= n ? n - 1 : i);
+	}
+}
+
+static void _texel(const rs_tex_t * t, int32_t x, int32_t y, float out[4])
+{
+	x = _wrap(x, t->w, (t->flags & BGFX_TEXTURE_U_MASK) >> BGFX_TEXTURE_U_SHIFT);
+	y = _wrap(y, t->h, (t->flags & BGFX_TEXTURE_V_MASK) >> BGFX_TEXTURE_V_SHIFT);
+
+	if(t->bpp == 1)
+	{
+		out[0] = t->data[(size_t)y * t->w + x] / 255.0f;
+		out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+		return;
+	}
+
+	const uint8_t * p = t->data + ((size_t)y * t->w + x) * 4;
+	for(uint8_t i = 0; i < 4; ++i)
+		out[i] = p[i] / 255.0f;
+}
+
+static void _sample(const rs_tex_t * t, float u, float v, float out[4])
+{
+	if(!t || !t->data)
+	{
+		// same as missing texture
+		out[0] = out[2] = out[3] = 1.0f;
+		out[1] = 0.0f;
+		return;
+	}
+
+	float x = u * t->w, y = v * t->h;
+	if(t->flags & (BGFX_TEXTURE_MIN_POINT | BGFX_TEXTURE_MAG_POINT))
+	{
+		_texel(t, (int32_t)floorf(x), (int32_t)floorf(y), out);
+		return;
+	}
+
+	// bilinear, texel centers are at .5
+	x -= 0.5f;
+	y -= 0.5f;
+	float fx = floorf(x), fy = floorf(y);
+	float ax = x - fx, ay = y - fy;
+	int32_t ix = (int32_t)fx, iy = (int32_t)fy;
+
+	float t00[4], t10[4], t01[4], t11[4];
+	_texel(t, ix, iy, t00);
+	_texel(t, ix + 1, iy, t10);
+	_texel(t, ix, iy + 1, t01);
+	_texel(t, ix + 1, iy + 1, t11);
+	for(uint8_t i = 0; i < 4; ++i)
+		out[i] = (t00[i] * (1.0f - ax) + t10[i] * ax) * (1.0f - ay) + (t01[i] * (1.0f - ax) + t11[i] * ax) * ay;
+}
+
+static float _smoothstep(float e0, float e1, float x)
+{
+	float t = (x - e0) / (e1 - e0);
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+// -----------------------------------------------------------------------------
+// blending
+
+static float _factor(uint32_t f, const float src[4], const float dst[4], uint8_t ch)
+{
+	switch(f)
+	{
+	case 1: return 0.0f; // zero
+	case 2: return 1.0f; // one
+	case 3: return src[ch];
+	case 4: return 1.0f - src[ch];
+	case 5: return src[3];
+	case 6: return 1.0f - src[3];
+	case 7: return dst[3];
+	case 8: return 1.0f - dst[3];
+	case 9: return dst[ch];
+	case 10: return 1.0f - dst[ch];
+	case 11: return ch < 3 ? gb_min(src[3], 1.0f - dst[3]) : 1.0f; // src alpha saturate
+	default: return 1.0f; // blend factor uniform is never set
+	}
+}
+
+static float _equation(uint32_t eq, float s, float d)
+{
+	switch(eq)
+	{
+	case 1: return s - d;
+	case 2: return d - s;
+	case 3: return gb_min(s, d);
+	case 4: return gb_max(s, d);
+	default: return s + d;
+	}
+}
+
+static void _blend(uint8_t * p, const float src[4], uint64_t state)
+{
+	float dst[4], out[4];
+	for(uint8_t i = 0; i < 4; ++i)
+		dst[i] = p[i] / 255.0f;
+
+	uint32_t blend = (uint32_t)((state & BGFX_STATE_BLEND_MASK) >> BGFX_STATE_BLEND_SHIFT);
+	uint32_t eq = (uint32_t)((state & BGFX_STATE_BLEND_EQUATION_MASK) >> BGFX_STATE_BLEND_EQUATION_SHIFT);
+
+	if(!blend)
+		memcpy(out, src, sizeof(out));
+	else
+		for(uint8_t i = 0; i < 4; ++i)
+		{
+			// rgb factors in low byte, alpha in high byte, min and max ignore factors like gpus do
+			uint32_t sf = i < 3 ? (blend & 0xf) : ((blend >> 8) & 0xf);
+			uint32_t df = i < 3 ? ((blend >> 4) & 0xf) : ((blend >> 12) & 0xf);
+			uint32_t e = i < 3 ? (eq & 0x7) : ((eq >> 3) & 0x7);
+			if(e == 3 || e == 4)
+				out[i] = _equation(e, src[i], dst[i]);
+			else
+				out[i] = _equation(e, src[i] * _factor(sf, src, dst, i), dst[i] * _factor(df, src, dst, i));
+		}
+
+	for(uint8_t i = 0; i < 4; ++i)
+	{
+		if(i < 3 ? !(state & BGFX_STATE_RGB_WRITE) : !(state & BGFX_STATE_ALPHA_WRITE))
+			continue;
+		float v = out[i] < 0.0f ? 0.0f : (out[i] > 1.0f ? 1.0f : out[i]);
+		p[i] = (uint8_t)(v * 255.0f + 0.5f);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// rasterisation
+
+static float _edge(const rs_vert_t * a, const rs_vert_t * b, float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+// d3d style top-left fill rule for clockwise triangles in y down space
+static bool _top_left(const rs_vert_t * a, const rs_vert_t * b)
+{
+	float dx = b->x - a->x, dy = b->y - a->y;
+	return (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+}
+
+static void _triangle(const rs_cmd_t * d, const rs_tex_t * tex, const rs_vert_t * a, const rs_vert_t * b, const rs_vert_t * c)
+{
+	float area = _edge(a, b, c->x, c->y);
+	if(area == 0.0f)
+		return;
+
+	// world is y up and framebuffer is y down, so triangles which are clockwise in world have positive area here
+	uint64_t cull = d->state & BGFX_STATE_CULL_MASK;
+	if((cull == BGFX_STATE_CULL_CCW && area < 0.0f) || (cull == BGFX_STATE_CULL_CW && area > 0.0f))
+		return;
+	if(area < 0.0f)
+	{
+		const rs_vert_t * t = b;
+		b = c;
+		c = t;
+		area = -area;
+	}
+
+	int32_t x1 = (int32_t)floorf(gb_min(a->x, gb_min(b->x, c->x)));
+	int32_t y1 = (int32_t)floorf(gb_min(a->y, gb_min(b->y, c->y)));
+	int32_t x2 = (int32_t)ceilf(gb_max(a->x, gb_max(b->x, c->x))) + 1;
+	int32_t y2 = (int32_t)ceilf(gb_max(a->y, gb_max(b->y, c->y))) + 1;
+	x1 = gb_max(x1, d->clip[0]);
+	y1 = gb_max(y1, d->clip[1]);
+	x2 = gb_min(x2, d->clip[2]);
+	y2 = gb_min(y2, d->clip[3]);
+	if(x1 >= x2 || y1 >= y2)
+		return;
+
+	// attributes are affine in 2d, so they are planes over screen space
+	float ddx[6], ddy[6];
+	for(uint8_t k = 0; k < 6; ++k)
+	{
+		float fb = b->a[k] - a->a[k], fc = c->a[k] - a->a[k];
+		ddx[k] = (fb * (c->y - a->y) - fc * (b->y - a->y)) / area;
+		ddy[k] = (fc * (b->x - a->x) - fb * (c->x - a->x)) / area;
+	}
+
+	bool tl0 = _top_left(b, c), tl1 = _top_left(c, a), tl2 = _top_left(a, b);
+
+	for(int32_t y = y1; y < y2; ++y)
+	{
+		float py = (float)y + 0.5f;
+		for(int32_t x = x1; x < x2; ++x)
+		{
+			float px = (float)x + 0.5f;
+			float w0 = _edge(b, c, px, py), w1 = _edge(c, a, px, py), w2 = _edge(a, b, px, py);
+			if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f || (w0 == 0.0f && !tl0) || (w1 == 0.0f && !tl1) || (w2 == 0.0f && !tl2))
+				continue;
+
+			float v[6];
+			for(uint8_t k = 0; k < 6; ++k)
+				v[k] = a->a[k] + ddx[k] * (px - a->x) + ddy[k] * (py - a->y);
+
+			float t[4], src[4];
+			_sample(tex, v[0], v[1], t);
+
+			switch(d->shader)
+			{
+			case RS_SHADER_TEXT:
+				src[0] = v[2]; src[1] = v[3]; src[2] = v[4];
+				src[3] = v[5] * t[0];
+				break;
+			case RS_SHADER_SDF:
+			{
+				// fwidth from neighbour pixels, uv is linear so this matches hardware derivatives
+				float tx[4], ty[4];
+				_sample(tex, v[0] + ddx[0], v[1] + ddx[1], tx);
+				_sample(tex, v[0] + ddy[0], v[1] + ddy[1], ty);
+				float w = gb_max((fabsf(tx[0] - t[0]) + fabsf(ty[0] - t[0])) * 0.5f, 0.001f);
+				src[0] = v[2]; src[1] = v[3]; src[2] = v[4];
+				src[3] = v[5] * _smoothstep(0.5f - w, 0.5f + w, t[0]);
+				break;
+			}
+			default:
+				for(uint8_t k = 0; k < 4; ++k)
+					src[k] = t[k] * v[2 + k];
+				break;
+			}
+
+			_blend(ctx.fb + ((size_t)y * ctx.fb_w + x) * 4, src, d->state);
+		}
+	}
+}
+
+static void _vert(rs_vert_t * out, const vrtx_t * in)
+{
+	const float * m = ctx.m.e;
+	out->x = m[0] * in->x + m[4] * in->y + m[8] * in->z + m[12];
+	out->y = m[1] * in->x + m[5] * in->y + m[9] * in->z + m[13];
+	out->a[0] = in->u;
+	out->a[1] = in->v;
+	out->a[2] = (float)((in->color >>  0) & 0xff) / 255.0f;
+	out->a[3] = (float)((in->color >>  8) & 0xff) / 255.0f;
+	out->a[4] = (float)((in->color >> 16) & 0xff) / 255.0f;
+	out->a[5] = (float)((in->color >> 24) & 0xff) / 255.0f;
+}
+
+void rs_draw(bgfx_texture_handle_t tex, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog)
+{
+	// only triangle lists are supported, debug lines are skipped
+	if(state & BGFX_STATE_PT_MASK)
+		return;
+
+	rs_cmd_t * c = _cmd();
+	c->tex = tex.idx;
+	c->state = state;
+	c->shader = prog.idx == r_prog_text().idx ? RS_SHADER_TEXT : (prog.idx == r_prog_sdf().idx ? RS_SHADER_SDF : RS_SHADER_TEX_COLOR);
+	if(scissor)
+	{
+		int32_t sx = (uint16_t)scissor, sy = (uint16_t)(scissor >> 16);
+		c->clip[0] = gb_max(c->clip[0], sx);
+		c->clip[1] = gb_max(c->clip[1], sy);
+		c->clip[2] = gb_min(c->clip[2], sx + (int32_t)(uint16_t)(scissor >> 32));
+		c->clip[3] = gb_min(c->clip[3], sy + (int32_t)(uint16_t)(scissor >> 48));
+	}
+
+	if(!i)
+	{
+		for(uint32_t q = 0; q + 3 < vc; q += 4)
+		{
+			rs_vert_t * p = _verts(6);
+			_vert(p + 0, v + q + 0);
+			_vert(p + 1, v + q + 1);
+			_vert(p + 2, v + q + 2);
+			p[3] = p[0];
+			p[4] = p[2];
+			_vert(p + 5, v + q + 3);
+		}
+	}
+	else
+	{
+		for(uint32_t t = 0; t + 2 < ic; t += 3)
+		{
+			if(i[t] >= vc || i[t + 1] >= vc || i[t + 2] >= vc)
+				continue;
+			rs_vert_t * p = _verts(3);
+			for(uint8_t k = 0; k < 3; ++k)
+				_vert(p + k, v + i[t + k]);
+		}
+	}
+
+	c->count = (ctx.verts_count - c->first) / 3;
+	if(!c->count || c->clip[0] >= c->clip[2] || c->clip[1] >= c->clip[3])
+	{
+		ctx.verts_count = c->first;
+		ctx.cmds_count--;
+	}
+}
+
+void rs_draw_static(bgfx_texture_handle_t tex, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, uint32_t i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog)
+{
+	const rs_buffer_t * b = vbuf.idx < RS_MAX_BUFFERS ? ctx.buffers[vbuf.idx] : NULL;
+	if(!b || v + vc > b->vc || i + ic > b->ic)
+		return;
+
+	// indexes are relative to first vertex of the range
+	rs_draw(tex, b->v + v, vc, b->i + i, ic, state, scissor, prog);
+}
+
+void rs_frame()
+{
+	for(uint32_t i = 0; i < ctx.cmds_count && ctx.fb; ++i)
+	{
+		const rs_cmd_t * c = ctx.cmds + i;
+		if(!c->count)
+		{
+			for(int32_t y = c->clip[1]; y < c->clip[3]; ++y)
+				for(int32_t x = c->clip[0]; x < c->clip[2]; ++x)
+					memcpy(ctx.fb + ((size_t)y * ctx.fb_w + x) * 4, c->clear, 4);
+			continue;
+		}
+
+		const rs_tex_t * tex = c->tex < RS_MAX_TEXTURES ? ctx.tex[c->tex] : NULL;
+		for(uint32_t t = 0; t < c->count; ++t)
+		{
+			const rs_vert_t * p = ctx.verts + c->first + t * 3;
+			_triangle(c, tex, p + 0, p + 1, p + 2);
+		}
+	}
+	ctx.cmds_count = 0;
+	ctx.verts_count = 0;
+
+	for(uint16_t i = 0; i < ctx.pending_free_count; ++i)
+		_tex_free(ctx.pending_free[i]);
+	ctx.pending_free_count = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+const uint8_t * rs_pixels(uint16_t * w, uint16_t * h)
+{
+	if(w)
+		*w = ctx.fb_w;
+	if(h)
+		*h = ctx.fb_h;
+	return ctx.fb;
+}
+
+bool rs_write_png(const char * filename)
+{
+	if(!ctx.fb)
+		return false;
+	return stbi_write_png_fs(filename, ctx.fb_w, ctx.fb_h, 4, ctx.fb, ctx.fb_w * 4) != 0;
+}
+
+#else
+
+void rs_deinit() {}
+void rs_resize(uint16_t w, uint16_t h) {}
+void rs_frame() {}
+void rs_texture(bgfx_texture_handle_t tex, uint16_t w, uint16_t h, bgfx_texture_format_t format, uint32_t flags, const void * data) {}
+void rs_texture_ktx(bgfx_texture_handle_t tex, const void * data, uint32_t size, uint32_t flags) {}
+void rs_texture_update(bgfx_texture_handle_t tex, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const void * data, uint16_t pitch) {}
+void rs_texture_free(bgfx_texture_handle_t tex) {}
+void rs_static(bgfx_vertex_buffer_handle_t vbuf, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic) {}
+void rs_static_free(bgfx_vertex_buffer_handle_t vbuf) {}
+void rs_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool clear, uint32_t rgba) {}
+void rs_draw(bgfx_texture_handle_t tex, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog) {}
+void rs_draw_static(bgfx_texture_handle_t tex, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, uint32_t i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog) {}
+const uint8_t * rs_pixels(uint16_t * w, uint16_t * h) {return NULL;}
+bool rs_write_png(const char * filename) {return false;}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// cpu reference rasteriser, mirrors everything submitted to bgfx into its own framebuffer
+// so output of batching, atlas and transform changes can be checked without gpu
+// only built with R_SOFT (SOFT_RASTER cmake option), otherwise all functions are empty
+// supports triangle lists, blending, scissors and the three builtin programs, no mipmaps
+// like in bgfx, texture updates of a frame apply before its draws and frees after them, so draws are recorded and rasterised in rs_frame
+
+#include "render.h"
+
+void rs_deinit();
+void rs_resize(uint16_t w, uint16_t h); // framebuffer size, content is lost
+void rs_frame(); // rasterises recorded draws, call right before bgfx_frame
+
+// texture mirrors, data can be NULL, pitch UINT16_MAX means tightly packed
+// supports RGBA8, BGRA8 and R8, anything else is sampled as magenta
+void rs_texture(bgfx_texture_handle_t tex, uint16_t w, uint16_t h, bgfx_texture_format_t format, uint32_t flags, const void * data);
+void rs_texture_ktx(bgfx_texture_handle_t tex, const void * data, uint32_t size, uint32_t flags); // only uncompressed RGBA8 ktx are decoded
+void rs_texture_update(bgfx_texture_handle_t tex, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const void * data, uint16_t pitch);
+void rs_texture_free(bgfx_texture_handle_t tex);
+
+// persistent buffers for rs_draw_static
+void rs_static(bgfx_vertex_buffer_handle_t vbuf, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic);
+void rs_static_free(bgfx_vertex_buffer_handle_t vbuf);
+
+// view rect in framebuffer pixels, world space is mapped with current tr_get_vpv
+void rs_viewport(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool clear, uint32_t rgba);
+
+// same streams as bgfx gets, i is NULL for quads in 0 1 2 0 2 3 order, scissor is packed x y w h or 0
+void rs_draw(bgfx_texture_handle_t tex, const vrtx_t * v, uint32_t vc, const uint16_t * i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog);
+void rs_draw_static(bgfx_texture_handle_t tex, bgfx_vertex_buffer_handle_t vbuf, uint32_t v, uint32_t vc, uint32_t i, uint32_t ic, uint64_t state, uint64_t scissor, bgfx_program_handle_t prog);
+
+const uint8_t * rs_pixels(uint16_t * w, uint16_t * h); // rgba8, NULL if not built with R_SOFT
+bool rs_write_png(const char * filename);
@@ -1,12 +1,17 @@
 
 #include "render_text.h"
 #include "render.h"
+#include "render_soft.h"
+#include "profiler.h"
 #include "filesystem.h"
 #include "portable.h"
+#include <entrypoint.h>
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <khash.h>
+#include <stb_rect_pack.h>
 
 #define FONTSTASH_IMPLEMENTATION
 #include <fontstash.h>
@@ -17,13 +22,34 @@
 
 #ifdef NF
 #include <nativefonts.h>
-#include <khash.h>
+
+#ifndef NF_ATLAS_SIZE
+#define NF_ATLAS_SIZE (1024)
+#endif
+
+#ifndef NF_RASTER_BUDGET_MS
+#define NF_RASTER_BUDGET_MS (2.0) // strings over budget are drawn in later frames, at least one is done per frame
+#endif
+
+#define NF_CANVAS_W (512)
+#define NF_CANVAS_H (128)
+#define NF_SLOT_STEP_W (32) // slot sizes are rounded, so labels which change a bit can reuse each other's slots
+#define NF_SLOT_STEP_H (16)
+#define NF_MAX_FREE (256)
 
 typedef struct
 {
-	bgfx_texture_handle_t tex;
-	uint16_t w, h;
-	nf_aabb_t aabb;
+	uint16_t x, y, w, h;
+} nf_slot_t;
+
+typedef struct
+{
+	nf_aabb_t aabb; // text bounds in canvas
+	nf_slot_t slot; // in atlas
+	uint16_t tx, ty; // text position in atlas, slot has a border
+	bool ready; // rasterized and uploaded
+	bool failed; // didn't fit in atlas, retried only after some slot is freed
+	uint32_t failed_gen; // nf_free_gen at failure
 	uint8_t ttl; // in frames
 } nf_tex_t;
 
@@ -31,76 +57,211 @@ KHASH_MAP_INIT_STR(nf_text_map, nf_tex_t)
 
 #endif
 
-static struct
+#ifndef T_CACHE_TTL
+#define T_CACHE_TTL (30) // frames without drawing before cached layout is dropped
+#endif
+
+// glyph quads of one string at origin, only valid while it's atlas page keeps it's size and glyphs
+typedef struct
+{
+	char * text;
+	font_t font;
+	float size, spacing;
+	uint8_t align;
+	bool sdf;
+
+	vrtx_t * quads; // 4 per glyph, white
+	uint16_t count;
+	float bounds[4];
+	bool built;
+	uint8_t page;
+	uint32_t page_gen;
+	uint8_t ttl;
+} t_layout_t;
+
+KHASH_MAP_INIT_INT64(t_layout_map, t_layout_t)
+
+#ifndef T_ATLAS_PAGES
+#define T_ATLAS_PAGES (4)
+#endif
+
+#ifndef T_ATLAS_MAX_SIZE
+#define T_ATLAS_MAX_SIZE (2048) // full page is expanded up to this size before next one is used
+#endif
+
+#define T_RETIRED_MAX (16)
+
+// every page is a separate fontstash context with it's own glyph cache
+typedef struct
 {
 	FONScontext * fons;
 	bool tex_valid;
 	bgfx_texture_handle_t tex;
 	uint32_t tex_w, tex_h;
+	uint32_t gen; // bumped when glyph uv's change
+	uint32_t last_used; // frame, pages are evicted in lru order
+	bool full; // glyph didn't fit even after expanding
+} t_page_t;
+
+typedef struct
+{
+	fsmap_t file; // fontstash reads glyphs straight from it
+	char name[64];
+} t_font_file_t;
+
+#ifndef T_MAX_FONTS
+#define T_MAX_FONTS (32)
+#endif
+
+#ifndef T_SDF_SIZE
+#define T_SDF_SIZE (32) // glyph height in pixels in sdf atlas, bigger ones might need bigger FONS_SCRATCH_BUF_SIZE
+#endif
+
+#ifndef T_SDF_ATLAS
+#define T_SDF_ATLAS (512)
+#endif
+
+#define T_SDF_PADDING (4) // distance range in pixels around glyph edge
+
+// in T_SDF_SIZE pixels, y down like in fontstash
+typedef struct
+{
+	int index;
+	float advance;
+	int16_t x0, y0, x1, y1; // quad, includes padding
+	int16_t bx0, by0, bx1, by1; // glyph box, for bounds
+	float s0, t0, s1, t1;
+	bool has_quad; // false for spaces and glyphs which didn't fit
+} t_sdf_glyph_t;
+
+KHASH_MAP_INIT_INT64(t_sdf_glyph_map, t_sdf_glyph_t) // font << 32 | codepoint
+
+static struct
+{
+	t_page_t pages[T_ATLAS_PAGES];
+	uint8_t pages_count;
+	uint8_t page_current; // new glyphs go here
+	uint32_t page_w, page_h; // initial size
+	uint32_t frame;
+
+	// replaced textures might still be referenced by pending draws, so they live until next frame
+	bgfx_texture_handle_t retired[T_RETIRED_MAX];
+	uint8_t retired_count;
+
+	uint32_t expands, evictions; // since last t_stats
+
+	t_font_file_t * font_files;
+	size_t font_files_count;
 
 	float draw_x, draw_y;
 	float shadow_x, shadow_y;
 	gbRect2 bounds;
 
+	kh_t_layout_map_t * layouts;
+	vrtx_t * scratch; // cached quads are copied here, transient rendering modifies them in place
+	uint32_t scratch_cap;
+
+	// distance field glyphs are rasterized once and serve every size and scale
+	bool sdf_fonts[T_MAX_FONTS];
+	bool sdf_tex_valid;
+	bgfx_texture_handle_t sdf_tex;
+	uint8_t * sdf_data;
+	uint16_t sdf_dirty[4]; // x1 y1 x2 y2, uploaded once per frame
+	stbrp_context sdf_packer;
+	stbrp_node sdf_nodes[T_SDF_ATLAS];
+	kh_t_sdf_glyph_map_t * sdf_glyphs;
+
 #ifdef NF
 	nf_font_t nf_font;
 	kh_nf_text_map_t * nf_map;
+
+	// every string lives in a slot of one shared atlas
+	bool nf_tex_valid;
+	bgfx_texture_handle_t nf_tex;
+	stbrp_context nf_packer;
+	stbrp_node nf_nodes[NF_ATLAS_SIZE];
+	nf_slot_t nf_free[NF_MAX_FREE];
+	uint16_t nf_free_count;
+	uint32_t nf_slots_used; // packer is reset once none are, so slots dropped from full free list come back
+	uint32_t nf_free_gen; // bumped when a slot is freed
+	bool nf_full; // logged already, cleared by next free
+	uint8_t * nf_canvas; // nf_print target, reused
+	double nf_raster_ms; // spent in current frame
+	uint16_t nf_raster_count;
 #endif
 } ctx = {0};
 
+#ifdef NF
+static void _nf_slot_free(nf_slot_t slot);
+#endif
+
+static void _upload(bgfx_texture_handle_t tex, const uint8_t * data, uint32_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
 static void _tex_delete(void * userptr)
 {
-	if(ctx.tex_valid)
+	t_page_t * page = (t_page_t*)userptr;
+	if(page->tex_valid)
 	{
-		bgfx_destroy_texture(ctx.tex);
-		ctx.tex_valid = false;
+		rs_texture_free(page->tex);
+		bgfx_destroy_texture(page->tex);
+		page->tex_valid = false;
 	}
 }
 
 static int _tex_resize(void * userptr, int width, int height)
 {
-	if(ctx.tex_valid)
-		_tex_delete(userptr);
-	ctx.tex = bgfx_create_texture_2d(width, height, false, 1, BGFX_TEXTURE_FORMAT_RGBA8, BGFX_TEXTURE_NONE, NULL);
-	ctx.tex_w = width;
-	ctx.tex_h = height;
-	ctx.tex_valid = true;
+	t_page_t * page = (t_page_t*)userptr;
+	if(page->tex_valid)
+	{
+		// draws earlier in this frame still use old texture, so glyphs added since last flush go there too
+		// fontstash still has old data and dirty rect at this point, new texture gets everything again after expand
+		int dirty[4];
+		if(page->fons && fonsValidateTexture(page->fons, dirty))
+			_upload(page->tex, fonsGetTextureData(page->fons, NULL, NULL), page->tex_w, dirty[0], dirty[1], dirty[2] - dirty[0], dirty[3] - dirty[1]);
+
+		if(ctx.retired_count < T_RETIRED_MAX)
+			ctx.retired[ctx.retired_count++] = page->tex;
+		else
+		{
+			rs_texture_free(page->tex);
+			bgfx_destroy_texture(page->tex);
+		}
+	}
+	page->tex = bgfx_create_texture_2d(width, height, false, 1, BGFX_TEXTURE_FORMAT_R8, BGFX_TEXTURE_NONE, NULL);
+	rs_texture(page->tex, width, height, BGFX_TEXTURE_FORMAT_R8, BGFX_TEXTURE_NONE, NULL);
+	page->tex_w = width;
+	page->tex_h = height;
+	page->tex_valid = true;
+	page->gen++;
 	return 1;
 }
 
 static int _tex_create(void * userptr, int width, int height) {return _tex_resize(userptr, width, height);}
 
-static void _tex_update(void * userptr, int* rect, const unsigned char* data)
+// rows of single channel image go as they are, only the rect is copied
+static void _upload(bgfx_texture_handle_t tex, const uint8_t * data, uint32_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
-	if(!ctx.tex_valid)
+	if(!w || !h)
 		return;
 
-	uint32_t w = rect[2] - rect[0];
-	uint32_t h = rect[3] - rect[1];
-	uint32_t x = rect[0];
-	uint32_t y = rect[1];
+	const bgfx_memory_t * mem = bgfx_alloc(w * h);
+	for(uint32_t j = 0; j < h; ++j)
+		memcpy(mem->data + j * w, data + (j + y) * stride + x, w);
+	rs_texture_update(tex, x, y, w, h, mem->data, UINT16_MAX);
+	bgfx_update_texture_2d(tex, 0, 0, x, y, w, h, mem, UINT16_MAX);
+}
 
-	const bgfx_memory_t * mem = bgfx_alloc(w * h * 4);
-	bool once = true;
-	for(size_t j = 0; j < h; ++j)
-		for(size_t i = 0; i < w; ++i)
-		{
-			uint8_t c = data[(j + y) * ctx.tex_w + i + x];
-			if(c != 0 && c != 255 && once)
-			{
-				//ep_log("warn: blured font\n");
-				once = false;
-			}
-			//c = c > 127 ? 255 : 0; // hard clipping
-			//((r_color_t*)mem->data)[j * w + i] = r_coloru(c, c, c, 255);
-			((r_color_t*)mem->data)[j * w + i] = r_coloru(255, 255, 255, c);
-		}
-	bgfx_update_texture_2d(ctx.tex, 0, 0, x, y, w, h, mem, -1);
+static void _tex_update(void * userptr, int* rect, const unsigned char* data)
+{
+	t_page_t * page = (t_page_t*)userptr;
+	if(page->tex_valid)
+		_upload(page->tex, data, page->tex_w, rect[0], rect[1], rect[2] - rect[0], rect[3] - rect[1]);
 }
 
 static void _draw(void * userptr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts)
 {
-	if(!ctx.tex_valid)
+	t_page_t * page = (t_page_t*)userptr;
+	if(!page->tex_valid)
 		return;
 
 	vrtx_t * vert = (vrtx_t*)alloca(nverts * sizeof(vrtx_t));
@@ -133,23 +294,391 @@ static void _draw(void * userptr, const float* verts, const float* tcoords, cons
 		id[i * 3 + 2] = (uint16_t)(i * 3 + 1);
 	}
 
-	r_render_transient(vert, nverts, id, nverts, ctx.tex, 1.0f, 1.0f, 1.0f, 1.0f, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+	bgfx_program_handle_t def = {UINT16_MAX};
+	r_program(r_prog_text());
+	r_render_transient(vert, nverts, id, nverts, page->tex, 1.0f, 1.0f, 1.0f, 1.0f, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+	r_program(def);
 }
 
-void _t_init(uint32_t w, uint32_t h)
+static void _atlas_error(void * userptr, int error, int val)
+{
+	t_page_t * page = (t_page_t*)userptr;
+	if(error != FONS_ATLAS_FULL)
+		return;
+
+	// growing keeps existing glyphs, fontstash retries right after this
+	if(page->tex_w < T_ATLAS_MAX_SIZE || page->tex_h < T_ATLAS_MAX_SIZE)
+	{
+		fonsExpandAtlas(page->fons, gb_min(page->tex_w * 2, T_ATLAS_MAX_SIZE), gb_min(page->tex_h * 2, T_ATLAS_MAX_SIZE));
+		ctx.expands++;
+	}
+	else
+		page->full = true;
+}
+
+static void _page_create(t_page_t * page)
 {
 	FONSparams params;
 	memset(&params, 0, sizeof(params));
-	params.width = w;
-	params.height = h;
+	params.width = ctx.page_w;
+	params.height = ctx.page_h;
 	params.flags = (unsigned char)FONS_ZERO_TOPLEFT;
 	params.renderCreate = _tex_create;
 	params.renderResize = _tex_resize;
 	params.renderUpdate = _tex_update;
 	params.renderDraw = _draw;
 	params.renderDelete = _tex_delete;
-	params.userPtr = NULL;
-	ctx.fons = fonsCreateInternal(&params);
+	params.userPtr = page;
+	page->fons = fonsCreateInternal(&params);
+	fonsSetErrorCallback(page->fons, _atlas_error, page);
+
+	// same order as in t_add, so font ids match between pages
+	for(size_t i = 0; i < ctx.font_files_count; ++i)
+		fonsAddFontMem(page->fons, ctx.font_files[i].name, (unsigned char*)ctx.font_files[i].file.data, (int)ctx.font_files[i].file.size, 0);
+}
+
+// current page is full, continue in a new one or reset least recently used one
+static t_page_t * _page_next()
+{
+	if(ctx.pages_count < T_ATLAS_PAGES)
+	{
+		ctx.page_current = ctx.pages_count++;
+		_page_create(ctx.pages + ctx.page_current);
+		return ctx.pages + ctx.page_current;
+	}
+
+	// pages drawn this frame are still referenced by pending draws
+	int32_t lru = -1;
+	for(uint8_t i = 0; i < ctx.pages_count; ++i)
+		if(ctx.pages[i].last_used != ctx.frame && (lru < 0 || ctx.pages[i].last_used < ctx.pages[lru].last_used))
+			lru = i;
+
+	if(lru < 0)
+		return NULL;
+
+	t_page_t * page = ctx.pages + lru;
+	fonsResetAtlas(page->fons, page->tex_w, page->tex_h);
+	ctx.page_current = lru;
+	ctx.evictions++;
+	return page;
+}
+
+static uint64_t _fnv1a(uint64_t h, const void * data, size_t size)
+{
+	for(size_t i = 0; i < size; ++i)
+		h = (h ^ ((const uint8_t*)data)[i]) * 0x100000001b3ull;
+	return h;
+}
+
+static void _layout_free(t_layout_t * l)
+{
+	free(l->text);
+	free(l->quads);
+}
+
+static const t_sdf_glyph_t * _sdf_glyph(font_t id, unsigned int codepoint)
+{
+	int ret = 0;
+	khint_t k = kh_put_t_sdf_glyph_map(ctx.sdf_glyphs, ((uint64_t)id << 32) | codepoint, &ret);
+	t_sdf_glyph_t * g = &kh_value(ctx.sdf_glyphs, k);
+	if(!ret)
+		return g;
+
+	memset(g, 0, sizeof(t_sdf_glyph_t));
+
+	stbtt_fontinfo * info = &ctx.pages[0].fons->fonts[id]->font.font;
+	float scale = stbtt_ScaleForPixelHeight(info, T_SDF_SIZE);
+
+	int advance, lsb, x0, y0, x1, y1;
+	g->index = stbtt_FindGlyphIndex(info, codepoint);
+	stbtt_GetGlyphHMetrics(info, g->index, &advance, &lsb);
+	stbtt_GetGlyphBitmapBox(info, g->index, scale, scale, &x0, &y0, &x1, &y1);
+	g->advance = advance * scale;
+	g->bx0 = x0; g->by0 = y0;
+	g->bx1 = x1; g->by1 = y1;
+
+	// stb_truetype allocates from fontstash scratch, which is only reset per glyph
+	ctx.pages[0].fons->nscratch = 0;
+
+	int w, h, xoff, yoff;
+	uint8_t * sdf = stbtt_GetGlyphSDF(info, scale, g->index, T_SDF_PADDING, 128, 128.0f / T_SDF_PADDING, &w, &h, &xoff, &yoff);
+	if(!sdf)
+		return g;
+
+	if(!ctx.sdf_tex_valid)
+	{
+		ctx.sdf_tex = bgfx_create_texture_2d(T_SDF_ATLAS, T_SDF_ATLAS, false, 1, BGFX_TEXTURE_FORMAT_R8, BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP, NULL);
+		rs_texture(ctx.sdf_tex, T_SDF_ATLAS, T_SDF_ATLAS, BGFX_TEXTURE_FORMAT_R8, BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP, NULL);
+		ctx.sdf_data = (uint8_t*)calloc(T_SDF_ATLAS * T_SDF_ATLAS, 1);
+		stbrp_init_target(&ctx.sdf_packer, T_SDF_ATLAS, T_SDF_ATLAS, ctx.sdf_nodes, T_SDF_ATLAS);
+		ctx.sdf_tex_valid = true;
+	}
+
+	stbrp_rect r = {0};
+	r.w = w + 1; // field is ~0 at the border, one pixel gap is enough for filtering
+	r.h = h + 1;
+	stbrp_pack_rects(&ctx.sdf_packer, &r, 1);
+	if(!r.was_packed)
+	{
+		ep_log("%s: sdf atlas is full, increase T_SDF_ATLAS\n", __func__);
+		return g;
+	}
+
+	for(int j = 0; j < h; ++j)
+		memcpy(ctx.sdf_data + (r.y + j) * T_SDF_ATLAS + r.x, sdf + j * w, w);
+	ctx.sdf_dirty[0] = gb_min(ctx.sdf_dirty[0], r.x);
+	ctx.sdf_dirty[1] = gb_min(ctx.sdf_dirty[1], r.y);
+	ctx.sdf_dirty[2] = gb_max(ctx.sdf_dirty[2], r.x + w);
+	ctx.sdf_dirty[3] = gb_max(ctx.sdf_dirty[3], r.y + h);
+
+	g->x0 = xoff; g->y0 = yoff;
+	g->x1 = xoff + w; g->y1 = yoff + h;
+	g->s0 = (float)r.x / T_SDF_ATLAS;
+	g->t0 = (float)r.y / T_SDF_ATLAS;
+	g->s1 = (float)(r.x + w) / T_SDF_ATLAS;
+	g->t1 = (float)(r.y + h) / T_SDF_ATLAS;
+	g->has_quad = true;
+	return g;
+}
+
+// same metrics as fontstash, but without pixel snapping so it scales smoothly
+static void _layout_build_sdf(t_layout_t * l)
+{
+	size_t max_count = gb_min(strlen(l->text), UINT16_MAX / 4);
+	l->quads = (vrtx_t*)realloc(l->quads, (max_count ? max_count : 1) * 4 * sizeof(vrtx_t));
+	l->count = 0;
+	memset(l->bounds, 0, sizeof(l->bounds));
+
+	FONScontext * fons = ctx.pages[0].fons;
+	if(l->font < 0 || l->font >= fons->nfonts || !fons->fonts[l->font]->data)
+		return;
+
+	FONSfont * font = fons->fonts[l->font];
+	float k = l->size / T_SDF_SIZE;
+	float kern_scale = stbtt_ScaleForPixelHeight(&font->font.font, T_SDF_SIZE) * k;
+
+	float x = 0.0f;
+	float y = fons__getVertAlign(fons, font, l->align, (short)(l->size * 10.0f));
+	float minx = 0.0f, maxx = 0.0f, miny = y, maxy = y;
+
+	unsigned int state = 0, codepoint = 0;
+	int prev = -1;
+	for(const char * str = l->text; *str && l->count < max_count; ++str)
+	{
+		if(fons__decutf8(&state, &codepoint, *(const unsigned char*)str))
+			continue;
+
+		const t_sdf_glyph_t * g = _sdf_glyph(l->font, codepoint);
+		if(prev != -1)
+			x += stbtt_GetGlyphKernAdvance(&font->font.font, prev, g->index) * kern_scale + l->spacing;
+		prev = g->index;
+
+		if(g->bx0 != g->bx1)
+		{
+			minx = gb_min(minx, x + g->bx0 * k);
+			maxx = gb_max(maxx, x + g->bx1 * k);
+			miny = gb_min(miny, y + g->by0 * k);
+			maxy = gb_max(maxy, y + g->by1 * k);
+		}
+
+		if(g->has_quad)
+		{
+			float x0 = x + g->x0 * k, y0 = y + g->y0 * k;
+			float x1 = x + g->x1 * k, y1 = y + g->y1 * k;
+
+			// 0 1
+			// 3 2
+			vrtx_t * v = l->quads + l->count++ * 4;
+			v[0] = (vrtx_t){x0, -y0, 0.0f, g->s0, g->t0, 0xffffffff};
+			v[1] = (vrtx_t){x1, -y0, 0.0f, g->s1, g->t0, 0xffffffff};
+			v[2] = (vrtx_t){x1, -y1, 0.0f, g->s1, g->t1, 0xffffffff};
+			v[3] = (vrtx_t){x0, -y1, 0.0f, g->s0, g->t1, 0xffffffff};
+		}
+
+		x += g->advance * k;
+	}
+
+	float shift = 0.0f;
+	if(l->align & TEXT_ALIGN_RIGHT)
+		shift = -x;
+	else if(l->align & TEXT_ALIGN_CENTER)
+		shift = -x * 0.5f;
+
+	for(uint32_t i = 0; i < l->count * 4; ++i)
+		l->quads[i].x += shift;
+
+	l->bounds[0] = minx + shift;
+	l->bounds[1] = miny;
+	l->bounds[2] = maxx + shift;
+	l->bounds[3] = maxy;
+}
+
+static void _layout_fill(t_layout_t * l, t_page_t * page)
+{
+	page->last_used = ctx.frame;
+
+	fonsSetFont(page->fons, l->font);
+	fonsSetSize(page->fons, l->size);
+	fonsSetSpacing(page->fons, l->spacing);
+	fonsSetAlign(page->fons, l->align);
+	fonsSetBlur(page->fons, 0);
+
+	fonsTextBounds(page->fons, 0.0f, 0.0f, l->text, NULL, l->bounds);
+
+	// one glyph per byte at most
+	size_t max_count = gb_min(strlen(l->text), UINT16_MAX / 4);
+	l->quads = (vrtx_t*)realloc(l->quads, (max_count ? max_count : 1) * 4 * sizeof(vrtx_t));
+	l->count = 0;
+
+	FONStextIter iter;
+	FONSquad q;
+	fonsTextIterInit(page->fons, &iter, 0.0f, 0.0f, l->text, NULL);
+	while(l->count < max_count && fonsTextIterNext(page->fons, &iter, &q))
+	{
+		// missing glyphs and spaces
+		if(iter.prevGlyphIndex == -1 || q.x0 == q.x1 || q.y0 == q.y1)
+			continue;
+
+		// 0 1
+		// 3 2
+		vrtx_t * v = l->quads + l->count++ * 4;
+		v[0] = (vrtx_t){q.x0, -q.y0, 0.0f, q.s0, q.t0, 0xffffffff};
+		v[1] = (vrtx_t){q.x1, -q.y0, 0.0f, q.s1, q.t0, 0xffffffff};
+		v[2] = (vrtx_t){q.x1, -q.y1, 0.0f, q.s1, q.t1, 0xffffffff};
+		v[3] = (vrtx_t){q.x0, -q.y1, 0.0f, q.s0, q.t1, 0xffffffff};
+	}
+}
+
+static void _layout_build(t_layout_t * l)
+{
+	l->built = true;
+
+	if(l->sdf)
+	{
+		_layout_build_sdf(l);
+		return;
+	}
+
+	t_page_t * page = ctx.pages + ctx.page_current;
+	bool fresh = false;
+	for(uint8_t attempt = 0; attempt < 4; ++attempt)
+	{
+		uint32_t gen = page->gen;
+		page->full = false;
+		_layout_fill(l, page);
+
+		if(page->full)
+		{
+			// some glyphs are missing, whole string has to come from one page
+			t_page_t * next = fresh ? NULL : _page_next();
+			if(!next)
+			{
+				ep_log("%s: text atlas is full, increase T_ATLAS_PAGES or T_ATLAS_MAX_SIZE\n", __func__);
+				break;
+			}
+			page = next;
+			fresh = true;
+		}
+		else if(page->gen == gen)
+			break;
+		// otherwise page was expanded halfway, so earlier quads have old uv's
+	}
+
+	l->page = (uint8_t)(page - ctx.pages);
+	l->page_gen = page->gen;
+}
+
+static const t_layout_t * _layout_get(font_t font, float size, float spacing, uint8_t align, const char * text)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	h = _fnv1a(h, &font, sizeof(font));
+	h = _fnv1a(h, &size, sizeof(size));
+	h = _fnv1a(h, &spacing, sizeof(spacing));
+	h = _fnv1a(h, &align, sizeof(align));
+	h = _fnv1a(h, text, strlen(text));
+
+	int ret = 0;
+	khint_t k = kh_put_t_layout_map(ctx.layouts, h, &ret);
+	t_layout_t * l = &kh_value(ctx.layouts, k);
+
+	if(ret)
+		memset(l, 0, sizeof(t_layout_t));
+	else if(l->font != font || l->size != size || l->spacing != spacing || l->align != align || strcmp(l->text, text))
+	{
+		// hash collision, slot goes to the newer string
+		_layout_free(l);
+		memset(l, 0, sizeof(t_layout_t));
+	}
+
+	if(!l->text)
+	{
+		l->text = strdup(text);
+		l->font = font;
+		l->size = size;
+		l->spacing = spacing;
+		l->align = align;
+		l->sdf = font >= 0 && font < T_MAX_FONTS && ctx.sdf_fonts[font];
+	}
+
+	if(!l->built || (!l->sdf && l->page_gen != ctx.pages[l->page].gen))
+	{
+		PF_BEGIN("t_layout_build"); // cache miss, glyphs are rasterized here
+		_layout_build(l);
+		PF_END();
+	}
+
+	l->ttl = T_CACHE_TTL;
+	return l;
+}
+
+static void _layout_draw(const t_layout_t * l, float dx, float dy, float r, float g, float b, float a)
+{
+	if(!l->count || !(l->sdf ? ctx.sdf_tex_valid : ctx.pages[l->page].tex_valid))
+		return;
+
+	uint32_t count = l->count * 4;
+	if(count > ctx.scratch_cap)
+	{
+		ctx.scratch_cap = count;
+		ctx.scratch = (vrtx_t*)realloc(ctx.scratch, count * sizeof(vrtx_t));
+	}
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		ctx.scratch[i] = l->quads[i];
+		ctx.scratch[i].x += dx;
+		ctx.scratch[i].y += dy;
+	}
+
+	if(l->sdf)
+	{
+		bgfx_program_handle_t def = {UINT16_MAX};
+		r_program(r_prog_sdf());
+		r_render_transient_quads(ctx.scratch, l->count, ctx.sdf_tex, r, g, b, a, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+		r_program(def);
+	}
+	else
+	{
+		bgfx_program_handle_t def = {UINT16_MAX};
+		ctx.pages[l->page].last_used = ctx.frame;
+		r_program(r_prog_text());
+		r_render_transient_quads(ctx.scratch, l->count, ctx.pages[l->page].tex, r, g, b, a, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+		r_program(def);
+	}
+}
+
+void _t_init(uint32_t w, uint32_t h)
+{
+	ctx.page_w = w;
+	ctx.page_h = h;
+	ctx.frame = 1; // pages start with zero, so they are never treated as used in current frame
+	ctx.pages_count = 1;
+	ctx.page_current = 0;
+	_page_create(ctx.pages);
+	ctx.layouts = kh_init_t_layout_map();
+	ctx.sdf_glyphs = kh_init_t_sdf_glyph_map();
+	ctx.sdf_dirty[0] = ctx.sdf_dirty[1] = T_SDF_ATLAS;
+	ctx.sdf_dirty[2] = ctx.sdf_dirty[3] = 0;
 
 #ifdef NF
 	nf_font_params_t nf_params = {0};
@@ -165,21 +694,106 @@ void _t_deinit()
 	for(khint_t k = kh_begin(ctx.nf_map); k != kh_end(ctx.nf_map); ++k)
 	{
 		if(kh_exist(ctx.nf_map, k))
-		{
 			free((char*)kh_key(ctx.nf_map, k));
-			bgfx_destroy_texture(kh_value(ctx.nf_map, k).tex);
-		}
 	}
 	kh_clear_nf_text_map(ctx.nf_map);
 	kh_destroy_nf_text_map(ctx.nf_map);
 	nf_free(ctx.nf_font);
+
+	if(ctx.nf_tex_valid)
+	{
+		rs_texture_free(ctx.nf_tex);
+		bgfx_destroy_texture(ctx.nf_tex);
+	}
+	ctx.nf_tex_valid = false;
+	ctx.nf_free_count = 0;
+	ctx.nf_slots_used = 0;
+	ctx.nf_full = false;
+	free(ctx.nf_canvas);
+	ctx.nf_canvas = NULL;
 #endif
 
-	fonsDeleteInternal(ctx.fons);
+	for(khint_t k = kh_begin(ctx.layouts); k != kh_end(ctx.layouts); ++k)
+		if(kh_exist(ctx.layouts, k))
+			_layout_free(&kh_value(ctx.layouts, k));
+	kh_destroy_t_layout_map(ctx.layouts);
+	ctx.layouts = NULL;
+	free(ctx.scratch);
+	ctx.scratch = NULL;
+	ctx.scratch_cap = 0;
+
+	kh_destroy_t_sdf_glyph_map(ctx.sdf_glyphs);
+	ctx.sdf_glyphs = NULL;
+	if(ctx.sdf_tex_valid)
+	{
+		rs_texture_free(ctx.sdf_tex);
+		bgfx_destroy_texture(ctx.sdf_tex);
+	}
+	ctx.sdf_tex_valid = false;
+	free(ctx.sdf_data);
+	ctx.sdf_data = NULL;
+	memset(ctx.sdf_fonts, 0, sizeof(ctx.sdf_fonts));
+
+	for(uint8_t i = 0; i < ctx.pages_count; ++i)
+		fonsDeleteInternal(ctx.pages[i].fons);
+	memset(ctx.pages, 0, sizeof(ctx.pages));
+	ctx.pages_count = 0;
+
+	for(uint8_t i = 0; i < ctx.retired_count; ++i)
+	{
+		rs_texture_free(ctx.retired[i]);
+		bgfx_destroy_texture(ctx.retired[i]);
+	}
+	ctx.retired_count = 0;
+
+	for(size_t i = 0; i < ctx.font_files_count; ++i)
+		fsunmap(&ctx.font_files[i].file);
+	free(ctx.font_files);
+	ctx.font_files = NULL;
+	ctx.font_files_count = 0;
+}
+
+void _t_flush()
+{
+	// fontstash keeps union of dirty rects since last validation
+	for(uint8_t i = 0; i < ctx.pages_count; ++i)
+	{
+		int dirty[4];
+		if(fonsValidateTexture(ctx.pages[i].fons, dirty))
+			_tex_update(ctx.pages + i, dirty, fonsGetTextureData(ctx.pages[i].fons, NULL, NULL));
+	}
+
+	if(ctx.sdf_tex_valid && ctx.sdf_dirty[0] < ctx.sdf_dirty[2])
+	{
+		_upload(ctx.sdf_tex, ctx.sdf_data, T_SDF_ATLAS, ctx.sdf_dirty[0], ctx.sdf_dirty[1], ctx.sdf_dirty[2] - ctx.sdf_dirty[0], ctx.sdf_dirty[3] - ctx.sdf_dirty[1]);
+		ctx.sdf_dirty[0] = ctx.sdf_dirty[1] = T_SDF_ATLAS;
+		ctx.sdf_dirty[2] = ctx.sdf_dirty[3] = 0;
+	}
 }
 
 void _t_cleanup()
 {
+	ctx.frame++;
+
+	for(uint8_t i = 0; i < ctx.retired_count; ++i)
+	{
+		rs_texture_free(ctx.retired[i]);
+		bgfx_destroy_texture(ctx.retired[i]);
+	}
+	ctx.retired_count = 0;
+
+	for(khint_t k = kh_begin(ctx.layouts); k != kh_end(ctx.layouts); ++k)
+	{
+		if(!kh_exist(ctx.layouts, k))
+			continue;
+
+		if(!--kh_value(ctx.layouts, k).ttl)
+		{
+			_layout_free(&kh_value(ctx.layouts, k));
+			kh_del_t_layout_map(ctx.layouts, k);
+		}
+	}
+
 #ifdef NF
 	for(khint_t k = kh_begin(ctx.nf_map); k != kh_end(ctx.nf_map); ++k)
 	{
@@ -189,12 +803,16 @@ void _t_cleanup()
 		--kh_value(ctx.nf_map, k).ttl;
 		if(!kh_value(ctx.nf_map, k).ttl)
 		{
+			if(kh_value(ctx.nf_map, k).ready)
+				_nf_slot_free(kh_value(ctx.nf_map, k).slot);
 			free((char*)kh_key(ctx.nf_map, k));
-			bgfx_destroy_texture(kh_value(ctx.nf_map, k).tex);
 			kh_del_nf_text_map(ctx.nf_map, k);
 		}
 	}
 
+	ctx.nf_raster_ms = 0.0;
+	ctx.nf_raster_count = 0;
+
 //	printf("size %i\n", kh_size(ctx.nf_map));
 
 #endif
@@ -202,62 +820,199 @@ void _t_cleanup()
 
 font_t t_add(const char * fontname, const char * filename)
 {
-	int res = fonsGetFontByName(ctx.fons, fontname);
+	int res = fonsGetFontByName(ctx.pages[0].fons, fontname);
 	if(res != FONS_INVALID)
 		return res;
 
-	FILE * fp = fsopen(filename, "rb");
-	if(!fp)
+	fsmap_t map;
+	if(!fsmap(filename, &map))
 		return FONS_INVALID;
 
-	fseek(fp,0,SEEK_END);
-	size_t size = ftell(fp);
-	fseek(fp,0,SEEK_SET);
+	if(!map.size)
+	{
+		fsunmap(&map);
+		return FONS_INVALID;
+	}
 
-	if(!size)
+	// fontstash only reads font data, so mapping is used as is and released in _t_deinit
+	font_t font = fonsAddFontMem(ctx.pages[0].fons, fontname, (unsigned char*)map.data, (int)map.size, 0);
+	if(font == FONS_INVALID)
 	{
-		fclose(fp);
+		fsunmap(&map);
 		return FONS_INVALID;
 	}
 
-	uint8_t * data = (uint8_t*)malloc(size);
-	fread(data, 1, size, fp);
-	fclose(fp);
+	for(uint8_t i = 1; i < ctx.pages_count; ++i)
+		fonsAddFontMem(ctx.pages[i].fons, fontname, (unsigned char*)map.data, (int)map.size, 0);
+
+	ctx.font_files = (t_font_file_t*)realloc(ctx.font_files, (ctx.font_files_count + 1) * sizeof(t_font_file_t));
+	t_font_file_t * f = ctx.font_files + ctx.font_files_count++;
+	f->file = map;
+	strncpy(f->name, fontname, sizeof(f->name) - 1);
+	f->name[sizeof(f->name) - 1] = 0;
+	return font;
+}
+
+font_t t_add_sdf(const char * fontname, const char * filename)
+{
+	font_t font = t_add(fontname, filename);
+	if(font == FONS_INVALID)
+		return FONS_INVALID;
 
-	return fonsAddFontMem(ctx.fons, fontname, data, (int)size, 1);
+	if(font >= T_MAX_FONTS)
+	{
+		ep_log("%s: too many fonts, %s is rendered without sdf\n", __func__, fontname);
+		return font;
+	}
+
+	ctx.sdf_fonts[font] = true;
+	return font;
 }
 
 #ifdef NF // nativefonts rendering
+static bool _nf_slot_alloc(uint16_t w, uint16_t h, nf_slot_t * out)
+{
+	w = (w + NF_SLOT_STEP_W - 1) / NF_SLOT_STEP_W * NF_SLOT_STEP_W;
+	h = (h + NF_SLOT_STEP_H - 1) / NF_SLOT_STEP_H * NF_SLOT_STEP_H;
+
+	// same size first, then smallest one which fits
+	int32_t best = -1;
+	for(uint16_t i = 0; i < ctx.nf_free_count; ++i)
+	{
+		nf_slot_t f = ctx.nf_free[i];
+		if(f.w == w && f.h == h)
+		{
+			best = i;
+			break;
+		}
+		if(f.w >= w && f.h >= h && (best < 0 || f.w * f.h < ctx.nf_free[best].w * ctx.nf_free[best].h))
+			best = i;
+	}
+
+	if(best >= 0)
+	{
+		*out = ctx.nf_free[best];
+		ctx.nf_free[best] = ctx.nf_free[--ctx.nf_free_count];
+		ctx.nf_slots_used++;
+		return true;
+	}
+
+	stbrp_rect r = {0};
+	r.w = w;
+	r.h = h;
+	stbrp_pack_rects(&ctx.nf_packer, &r, 1);
+	if(!r.was_packed)
+		return false;
+
+	out->x = r.x;
+	out->y = r.y;
+	out->w = w;
+	out->h = h;
+	ctx.nf_slots_used++;
+	return true;
+}
+
+static void _nf_slot_free(nf_slot_t slot)
+{
+	ctx.nf_free_gen++;
+	ctx.nf_full = false;
+
+	// whole atlas is free again, so packer starts over instead of keeping fragments
+	if(!--ctx.nf_slots_used)
+	{
+		stbrp_init_target(&ctx.nf_packer, NF_ATLAS_SIZE, NF_ATLAS_SIZE, ctx.nf_nodes, NF_ATLAS_SIZE);
+		ctx.nf_free_count = 0;
+		return;
+	}
+
+	if(ctx.nf_free_count < NF_MAX_FREE)
+		ctx.nf_free[ctx.nf_free_count++] = slot;
+}
+
+static bool _nf_raster(nf_tex_t * t, const char * text)
+{
+	if(!ctx.nf_tex_valid)
+	{
+		ctx.nf_tex = bgfx_create_texture_2d(NF_ATLAS_SIZE, NF_ATLAS_SIZE, false, 1, BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP, NULL);
+		rs_texture(ctx.nf_tex, NF_ATLAS_SIZE, NF_ATLAS_SIZE, BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP, NULL);
+		stbrp_init_target(&ctx.nf_packer, NF_ATLAS_SIZE, NF_ATLAS_SIZE, ctx.nf_nodes, NF_ATLAS_SIZE);
+		ctx.nf_canvas = (uint8_t*)malloc(NF_CANVAS_W * NF_CANVAS_H * 4);
+		ctx.nf_tex_valid = true;
+	}
+
+	double time = hp_time();
+
+	memset(ctx.nf_canvas, 0, NF_CANVAS_W * NF_CANVAS_H * 4);
+	nf_print(ctx.nf_canvas, NF_CANVAS_W, NF_CANVAS_H, ctx.nf_font, NULL, 0, &t->aabb, text);
+
+	// one pixel border keeps neighbours out of filtering
+	uint16_t w = gb_min(t->aabb.w + 2, NF_CANVAS_W);
+	uint16_t h = gb_min(t->aabb.h + 2, NF_CANVAS_H);
+	if(!_nf_slot_alloc(w, h, &t->slot))
+	{
+		if(!ctx.nf_full)
+			ep_log("%s: native text atlas is full, increase NF_ATLAS_SIZE\n", __func__);
+		ctx.nf_full = true;
+		t->failed = true;
+		t->failed_gen = ctx.nf_free_gen;
+
+		// counts against budget too, otherwise every string which doesn't fit is rasterized each frame
+		ctx.nf_raster_ms += (hp_time() - time) * 1000.0;
+		ctx.nf_raster_count++;
+		return false;
+	}
+
+	uint16_t sx = t->aabb.x > 0 ? t->aabb.x - 1 : 0;
+	uint16_t sy = t->aabb.y > 0 ? t->aabb.y - 1 : 0;
+	w = gb_min(w, NF_CANVAS_W - sx);
+	h = gb_min(h, NF_CANVAS_H - sy);
+
+	const bgfx_memory_t * mem = bgfx_alloc(w * h * 4);
+	for(uint16_t j = 0; j < h; ++j)
+		memcpy(mem->data + j * w * 4, ctx.nf_canvas + ((sy + j) * NF_CANVAS_W + sx) * 4, w * 4);
+	rs_texture_update(ctx.nf_tex, t->slot.x, t->slot.y, w, h, mem->data, UINT16_MAX);
+	bgfx_update_texture_2d(ctx.nf_tex, 0, 0, t->slot.x, t->slot.y, w, h, mem, UINT16_MAX);
+
+	t->tx = t->slot.x + t->aabb.x - sx;
+	t->ty = t->slot.y + t->aabb.y - sy;
+	t->ready = true;
+	t->failed = false;
+
+	ctx.nf_raster_ms += (hp_time() - time) * 1000.0;
+	ctx.nf_raster_count++;
+	return true;
+}
+
 static void _r_nf(float r, float g, float b, float a, gbRect2 * out_bounds, uint8_t align, const char * text)
 {
 	khint_t k = kh_get_nf_text_map(ctx.nf_map, text);
 
 	if(k == kh_end(ctx.nf_map))
 	{
-		// create new texture then
 		nf_tex_t tn = {0};
-		tn.w = 512;
-		tn.h = 128;
-
-		// TODO add reusable pool later
-
-		const bgfx_memory_t * bitmap_mem = bgfx_alloc(tn.w * tn.h * 4);
-		nf_print(bitmap_mem->data, tn.w, tn.h, ctx.nf_font, NULL, 0, &tn.aabb, text);
-		tn.tex = bgfx_create_texture_2d(tn.w, tn.h, false, 1, BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_NONE, bitmap_mem);
-
 		int retk = 0;
 		k = kh_put_nf_text_map(ctx.nf_map, strdup(text), &retk);
 		kh_value(ctx.nf_map, k) = tn;
-
 	}
 
 	nf_tex_t * t = &kh_value(ctx.nf_map, k);
 	t->ttl = 3;
 
-	float u1 = (float)t->aabb.x / (float)t->w;
-	float v1 = (float)t->aabb.y / (float)t->h;
-	float u2 = (float)(t->aabb.x + t->aabb.w) / (float)t->w;
-	float v2 = (float)(t->aabb.y + t->aabb.h) / (float)t->h;
+	bool retry = !t->failed || t->failed_gen != ctx.nf_free_gen;
+	if(!t->ready && retry && (!ctx.nf_raster_count || ctx.nf_raster_ms < NF_RASTER_BUDGET_MS))
+		_nf_raster(t, text);
+
+	if(!t->ready)
+	{
+		if(out_bounds)
+			memset(out_bounds, 0, sizeof(gbRect2));
+		return;
+	}
+
+	float u1 = (float)t->tx / (float)NF_ATLAS_SIZE;
+	float v1 = (float)t->ty / (float)NF_ATLAS_SIZE;
+	float u2 = (float)(t->tx + t->aabb.w) / (float)NF_ATLAS_SIZE;
+	float v2 = (float)(t->ty + t->aabb.h) / (float)NF_ATLAS_SIZE;
 
 	vrtx_t sprite_vertices[4] =
 	{
@@ -277,15 +1032,9 @@ static void _r_nf(float r, float g, float b, float a, gbRect2 * out_bounds, uint
 		out_bounds->dim.y = sprite_vertices[0].y - sprite_vertices[2].y;
 	}
 
-	uint16_t sprite_indices[6] =
-	{
-		0, 1, 2, // TODO resolve dat shit with ccw vs cw
-		0, 2, 3,
-	};
-
 	// TODO support align
 
-	r_render_transient(sprite_vertices, 4, sprite_indices, 6, t->tex, r, g, b, a, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
+	r_render_transient_quads(sprite_vertices, 1, ctx.nf_tex, r, g, b, a, BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA);
 }
 #endif
 
@@ -302,7 +1051,7 @@ void r_text_ex2(font_t font,
 {
 	ctx.draw_x = x;
 	ctx.draw_y = y;
-	tr_set_world(tr_model_spr(x, y, deg, rox, roy, sx, sy, sox, soy, 1, 1, 0, 0));
+	tr_set_world2d(tr2d_model_spr(x, y, deg, rox, roy, sx, sy, sox, soy, 1, 1, 0, 0));
 
 	#ifdef NF
 
@@ -321,52 +1070,61 @@ void r_text_ex2(font_t font,
 	//vsnprintf(buffer, sizeof(buffer), text, args);
 	//va_end(args);
 
-	fonsSetFont(ctx.fons, font);
-	fonsSetSize(ctx.fons, size_in_pt);
-	fonsSetSpacing(ctx.fons, spacing_in_pt);
-	fonsSetAlign(ctx.fons, align);
-	fonsSetBlur(ctx.fons, 0);
-	fonsSetColor(ctx.fons, r_color(r, g, b, a));
+	// shaping, measuring and tesselation only happen when string is new or atlas changed
+	const t_layout_t * l = _layout_get(font, size_in_pt, spacing_in_pt, align, text);
 
-	float temp_bounds[4];
-	fonsTextBounds(ctx.fons, x, y, text, NULL, temp_bounds);
 	// TODO do we need to transform them?
-	ctx.bounds.pos.x = temp_bounds[0];
-	ctx.bounds.pos.y = temp_bounds[1];
-	ctx.bounds.dim.x = temp_bounds[2] - temp_bounds[0];
-	ctx.bounds.dim.y = temp_bounds[3] - temp_bounds[1]; // ?
+	ctx.bounds.pos.x = x + l->bounds[0];
+	ctx.bounds.pos.y = y + l->bounds[1];
+	ctx.bounds.dim.x = l->bounds[2] - l->bounds[0];
+	ctx.bounds.dim.y = l->bounds[3] - l->bounds[1]; // ?
 
 	if(out_bounds)
 		*out_bounds = ctx.bounds;
 
-	if(shadow)
+	// a bit of a hack
+	gbVec2 delta = gb_vec2_zero();
+	r_pixel_perfect_map(&delta.x, &delta.y, 2, 2);
+
+	if(shadow) // shadows don't follow pixel perfect rules
+		_layout_draw(l, delta.x + shadow_x, delta.y + shadow_y, shadow_r, shadow_g, shadow_b, shadow_a);
+
+	_layout_draw(l, delta.x, delta.y, r, g, b, a);
+}
+
+void t_stats(r_stats_t * stats)
+{
+	uint64_t used = 0, total = 0;
+	for(uint8_t i = 0; i < ctx.pages_count; ++i)
 	{
-		ctx.shadow_x = shadow_x;
-		ctx.shadow_y = shadow_y;
-		fonsPushState(ctx.fons);
-		fonsSetBlur(ctx.fons, 0.0f);
-		fonsSetColor(ctx.fons, r_color(shadow_r, shadow_g, shadow_b, shadow_a));
-		fonsDrawText(ctx.fons, x, y, text, NULL);
-		fonsPopState(ctx.fons);
+		// area under skyline, includes gaps packer can't use anymore
+		FONSatlas * atlas = ctx.pages[i].fons->atlas;
+		for(int j = 0; j < atlas->nnodes; ++j)
+			used += (uint64_t)atlas->nodes[j].width * atlas->nodes[j].y;
+		total += (uint64_t)atlas->width * atlas->height;
 	}
 
-	ctx.shadow_x = 0.0f;
-	ctx.shadow_y = 0.0f;
-	fonsDrawText(ctx.fons, x, y, text, NULL);
+	stats->glyph_pages += ctx.pages_count;
+	stats->glyph_occupancy = total ? (float)used / (float)total : 0.0f;
+	stats->glyph_expands += ctx.expands;
+	stats->glyph_evictions += ctx.evictions;
+	ctx.expands = 0;
+	ctx.evictions = 0;
 }
 
 void _r_text_debug_atlas(float k_size)
 {
-	tr_set_world(tr_model_spr(
+	tr_set_world2d(tr2d_model_spr(
 		0.0f, 0.0f,
 		0.0f, 0.0f, 0.0f,
 		k_size, k_size, 0.0f, 0.0f,
 		1.0f, 1.0f, 0.0f, 0.0f
 	));
+	t_page_t * page = ctx.pages + ctx.page_current;
 	fonsDrawDebug(
-		ctx.fons,
-		-(float)ctx.tex_w * k_size / 2.0f,
-		(float)ctx.tex_h * (k_size / 2.0f - 1.0f)
+		page->fons,
+		-(float)page->tex_w * k_size / 2.0f,
+		(float)page->tex_h * (k_size / 2.0f - 1.0f)
 	);
 //	tex_t tex;
 //	tex.tex = ctx.tex;
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <gb_math.h>
+#include "render.h"
 
 typedef int32_t font_t;
 
@@ -11,8 +12,10 @@ typedef int32_t font_t;
 void _t_init(uint32_t w, uint32_t h); // size of text texture atlas in pixels
 void _t_deinit();
 void _t_cleanup();
+void _t_flush(); // uploads glyphs added during the frame in one go, call before bgfx_frame
 
 font_t t_add(const char * fontname, const char * filename);
+font_t t_add_sdf(const char * fontname, const char * filename); // glyphs are distance fields, one rasterized size serves every size and scale
 
 #define TEXT_ALIGN_LEFT		(1 << 0) // horizontal align default
 #define TEXT_ALIGN_CENTER	(1 << 1)
@@ -33,4 +36,7 @@ void r_text_ex2(font_t font,
 	gbRect2 * out_bounds, uint8_t align, float size_in_pt, float spacing_in_pt,
 	const char * text);
 
-void _r_text_debug_atlas(float k_size);
+// adds text atlas counters gathered since previous call to stats and resets them
+void t_stats(r_stats_t * stats);
+
+void _r_text_debug_atlas(float k_size); // current atlas page
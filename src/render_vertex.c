@@ -0,0 +1,148 @@
+#include "render_vertex.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define RV_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define RV_NEON
+	#include <arm_neon.h>
+#endif
+
+// vrtx_t is packed, so all loads and stores here are unaligned, x and y are at offset 0
+
+#ifndef RV_NEON
+static void _transform_scalar(vrtx_t * vbuf, size_t count, const float m[6])
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		float x = vbuf[i].x;
+		float y = vbuf[i].y;
+		vbuf[i].x = m[0] * x + m[2] * y + m[4];
+		vbuf[i].y = m[1] * x + m[3] * y + m[5];
+	}
+}
+#endif
+
+// channel factors in 8.8 fixed point, so 256 is 1.0 and tints above 1 still brighten
+typedef struct
+{
+	uint16_t r, g, b, a;
+} rv_factor_t;
+
+// capped below 128 so (255 * m) >> 8 stays under 32768, packus saturates from signed 16 bit
+static uint16_t _factor(float f)
+{
+	return (uint16_t)(gb_clamp(f, 0.0f, 127.0f) * 256.0f + 0.5f);
+}
+
+static r_color_t _modulate_scalar(r_color_t c, rv_factor_t m)
+{
+	// (c * m) >> 8 saturated, exact for 1.0 and 0
+	const uint16_t f[4] = {m.r, m.g, m.b, m.a};
+	r_color_t r = 0;
+	for(uint8_t i = 0; i < 4; ++i)
+		r |= (r_color_t)gb_min((((c >> (i * 8)) & 0xff) * f[i]) >> 8, 0xff) << (i * 8);
+	return r;
+}
+
+#if defined(RV_SSE2)
+
+void rv_transform(vrtx_t * vbuf, size_t count, const float m[6])
+{
+	const __m128 ab = _mm_setr_ps(m[0], m[1], m[0], m[1]);
+	const __m128 cd = _mm_setr_ps(m[2], m[3], m[2], m[3]);
+	const __m128 t  = _mm_setr_ps(m[4], m[5], m[4], m[5]);
+
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128 p = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(vbuf + i)), (const __m64*)(vbuf + i + 1));
+		__m128 xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+		__m128 yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, ab), _mm_mul_ps(yy, cd)), t);
+		_mm_storel_pi((__m64*)(vbuf + i), r);
+		_mm_storeh_pi((__m64*)(vbuf + i + 1), r);
+	}
+
+	_transform_scalar(vbuf + i, count - i, m);
+}
+
+void rv_modulate(vrtx_t * vbuf, size_t count, r_colorf_t color)
+{
+	const rv_factor_t m = {_factor(color.r), _factor(color.g), _factor(color.b), _factor(color.a)};
+
+	// channel in high byte, so mulhi gives (c * m) >> 8, pack saturates it to 255
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mc = _mm_setr_epi16((short)m.r, (short)m.g, (short)m.b, (short)m.a, (short)m.r, (short)m.g, (short)m.b, (short)m.a);
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i c = _mm_setr_epi32((int)vbuf[i].color, (int)vbuf[i + 1].color, (int)vbuf[i + 2].color, (int)vbuf[i + 3].color);
+		__m128i lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, c), mc);
+		__m128i hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, c), mc);
+		__m128i r = _mm_packus_epi16(lo, hi);
+		vbuf[i + 0].color = (r_color_t)_mm_cvtsi128_si32(r);
+		vbuf[i + 1].color = (r_color_t)_mm_cvtsi128_si32(_mm_srli_si128(r, 4));
+		vbuf[i + 2].color = (r_color_t)_mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+		vbuf[i + 3].color = (r_color_t)_mm_cvtsi128_si32(_mm_srli_si128(r, 12));
+	}
+
+	for(; i < count; ++i)
+		vbuf[i].color = _modulate_scalar(vbuf[i].color, m);
+}
+
+#elif defined(RV_NEON)
+
+void rv_transform(vrtx_t * vbuf, size_t count, const float m[6])
+{
+	const float32x2_t ab = vld1_f32(m + 0);
+	const float32x2_t cd = vld1_f32(m + 2);
+	const float32x2_t t  = vld1_f32(m + 4);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		float32x2_t p = vld1_f32((const float*)(vbuf + i));
+		float32x2_t r = vmla_lane_f32(vmla_lane_f32(t, ab, p, 0), cd, p, 1);
+		vst1_f32((float*)(vbuf + i), r);
+	}
+}
+
+void rv_modulate(vrtx_t * vbuf, size_t count, r_colorf_t color)
+{
+	const rv_factor_t m = {_factor(color.r), _factor(color.g), _factor(color.b), _factor(color.a)};
+	const uint16_t f[4] = {m.r, m.g, m.b, m.a};
+	const uint16x4_t mc = vld1_u16(f);
+
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		uint32x2_t c = vdup_n_u32(vbuf[i].color);
+		c = vset_lane_u32(vbuf[i + 1].color, c, 1);
+		uint16x8_t c16 = vmovl_u8(vreinterpret_u8_u32(c));
+		uint16x4_t lo = vqshrn_n_u32(vmull_u16(vget_low_u16(c16), mc), 8);
+		uint16x4_t hi = vqshrn_n_u32(vmull_u16(vget_high_u16(c16), mc), 8);
+		uint8x8_t r = vqmovn_u16(vcombine_u16(lo, hi));
+		vbuf[i + 0].color = vget_lane_u32(vreinterpret_u32_u8(r), 0);
+		vbuf[i + 1].color = vget_lane_u32(vreinterpret_u32_u8(r), 1);
+	}
+
+	for(; i < count; ++i)
+		vbuf[i].color = _modulate_scalar(vbuf[i].color, m);
+}
+
+#else
+
+void rv_transform(vrtx_t * vbuf, size_t count, const float m[6])
+{
+	_transform_scalar(vbuf, count, m);
+}
+
+void rv_modulate(vrtx_t * vbuf, size_t count, r_colorf_t color)
+{
+	const rv_factor_t m = {_factor(color.r), _factor(color.g), _factor(color.b), _factor(color.a)};
+	for(size_t i = 0; i < count; ++i)
+		vbuf[i].color = _modulate_scalar(vbuf[i].color, m);
+}
+
+#endif
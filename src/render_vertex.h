@@ -0,0 +1,14 @@
+#pragma once
+
+// batched vertex kernels, SSE2 / NEON with scalar fallback
+
+#include "render.h"
+
+// m is 2d affine transform as {a, b, c, d, tx, ty}
+// x' = a * x + c * y + tx
+// y' = b * x + d * y + ty
+void rv_transform(vrtx_t * vbuf, size_t count, const float m[6]);
+
+// multiplies every vertex color by color per channel, in 8.8 fixed point and saturated like the float path
+// so tints above 1 brighten, e.g. hit flashes, factors are clamped to [0, 127]
+void rv_modulate(vrtx_t * vbuf, size_t count, r_colorf_t color);
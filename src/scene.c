@@ -1,65 +1,321 @@
 
 #include "scene.h"
+#include "render_batch.h"
+#include "render_soft.h"
+#include "profiler.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define SPRITE_STATE (BGFX_STATE_DEFAULT_2D | BGFX_STATE_BLEND_ALPHA)
+#define BAKE_MIN_RUN 4 // shorter runs are not worth the batch flush
+
+typedef struct
+{
+	bgfx_texture_handle_t tex;
+	uint32_t v, vc; // indexes are relative to v
+	uint32_t i, ic;
+} scene_bake_draw_t;
+
+typedef struct
+{
+	size_t first, count; // entities
+	size_t draw_first, draw_count;
+} scene_bake_run_t;
+
+struct scene_bake_t
+{
+	bgfx_vertex_buffer_handle_t vbuf;
+	bgfx_index_buffer_handle_t ibuf;
+	scene_bake_run_t * runs;
+	size_t runs_count;
+	scene_bake_draw_t * draws;
+	size_t draws_count;
+	scene_sprite_key_t * keys; // per entity, what baked vertexes were built from
+};
+
+static bool _update_sprite(scene_entity_t * e, scene_sprite_t * c);
+static void _draw_sprite(scene_entity_t * e, scene_sprite_t * c);
+
 void scene_free(scene_t * scene)
 {
 	if(scene->pass_callback)
 		scene->pass_callback(scene, SCENE_PASS_FREE);
 
+	scene_unbake(scene);
+
 	for(size_t i = 0; i < scene->textures_count; ++i)
-		r_free(*scene->textures[i]);
+		if(!r_load_cancel(scene->textures[i]))
+			r_free(*scene->textures[i]);
+}
+
+static bool _bakeable(scene_entity_t * e)
+{
+	return e->visible && e->sprite && !e->text && !e->callback;
+}
+
+void scene_bake(scene_t * scene)
+{
+	scene_unbake(scene);
+
+	if(!scene->entities_count)
+		return;
+
+	PF_BEGIN("scene_bake");
+	scene_bake_t * b = (scene_bake_t*)calloc(1, sizeof(scene_bake_t));
+	b->runs = (scene_bake_run_t*)malloc(scene->entities_count * sizeof(scene_bake_run_t));
+	b->draws = (scene_bake_draw_t*)malloc(scene->entities_count * sizeof(scene_bake_draw_t));
+	b->keys = (scene_sprite_key_t*)malloc(scene->entities_count * sizeof(scene_sprite_key_t));
+
+	vrtx_t * v = (vrtx_t*)malloc(scene->entities_count * 16 * sizeof(vrtx_t));
+	uint16_t * id = (uint16_t*)malloc(scene->entities_count * 6 * 9 * sizeof(uint16_t));
+	uint32_t v_count = 0;
+	uint32_t i_count = 0;
+
+	scene_bake_run_t * run = NULL;
+
+	for(size_t i = 0; i <= scene->entities_count; ++i)
+	{
+		scene_entity_t * e = i < scene->entities_count ? scene->entities[i] : NULL;
+
+		if(!e || !_bakeable(e))
+		{
+			// close current run, drop it if it's too short
+			if(run && run->count < BAKE_MIN_RUN)
+			{
+				scene_bake_draw_t * d = b->draws + run->draw_first;
+				v_count = d->v;
+				i_count = d->i;
+				b->draws_count = run->draw_first;
+				b->runs_count--;
+			}
+			run = NULL;
+			continue;
+		}
+
+		scene_sprite_t * c = e->sprite;
+		_update_sprite(e, c);
+
+		if(!run)
+		{
+			run = b->runs + b->runs_count++;
+			run->first = i;
+			run->count = 0;
+			run->draw_first = b->draws_count;
+			run->draw_count = 0;
+		}
+
+		uint32_t vc = c->tex_9slice ? 16 : 4;
+		uint32_t ic = c->tex_9slice ? 6 * 9 : 6;
+		const uint16_t quad_id[6] = {0, 1, 2, 0, 2, 3};
+		const uint16_t * src_id = c->tex_9slice ? r_9slice_indices() : quad_id;
+
+		scene_bake_draw_t * d = run->draw_count ? b->draws + b->draws_count - 1 : NULL;
+		if(!d || d->tex.idx != c->tex.tex.idx || d->vc + vc > UINT16_MAX)
+		{
+			d = b->draws + b->draws_count++;
+			d->tex = c->tex.tex;
+			d->v = v_count;
+			d->vc = 0;
+			d->i = i_count;
+			d->ic = 0;
+			run->draw_count++;
+		}
+
+		memcpy(v + v_count, c->cache_v, vc * sizeof(vrtx_t));
+		memcpy(b->keys + i, &c->cache_key, sizeof(scene_sprite_key_t));
+		for(uint32_t j = 0; j < ic; ++j)
+			id[i_count + j] = src_id[j] + (uint16_t)d->vc;
+
+		d->vc += vc;
+		d->ic += ic;
+		v_count += vc;
+		i_count += ic;
+		run->count++;
+	}
+
+	if(b->runs_count)
+	{
+		b->vbuf = bgfx_create_vertex_buffer(bgfx_copy(v, v_count * sizeof(vrtx_t)), r_decl(), BGFX_BUFFER_NONE);
+		b->ibuf = bgfx_create_index_buffer(bgfx_copy(id, i_count * sizeof(uint16_t)), BGFX_BUFFER_NONE);
+		rs_static(b->vbuf, v, v_count, id, i_count);
+		scene->bake = b;
+	}
+	else
+	{
+		free(b->runs);
+		free(b->draws);
+		free(b->keys);
+		free(b);
+	}
+
+	free(v);
+	free(id);
+	PF_END();
+}
+
+void scene_unbake(scene_t * scene)
+{
+	scene_bake_t * b = scene->bake;
+	if(!b)
+		return;
+
+	rs_static_free(b->vbuf);
+	bgfx_destroy_vertex_buffer(b->vbuf);
+	bgfx_destroy_index_buffer(b->ibuf);
+	free(b->runs);
+	free(b->draws);
+	free(b->keys);
+	free(b);
+	scene->bake = NULL;
+}
+
+// compared with keys from bake time, so a run which is back in its baked state is used again
+static bool _run_unchanged(scene_t * scene, scene_bake_t * b, scene_bake_run_t * run)
+{
+	for(size_t i = run->first; i < run->first + run->count; ++i)
+	{
+		scene_entity_t * e = scene->entities[i];
+		if(!_bakeable(e))
+			return false;
+		_update_sprite(e, e->sprite);
+		if(memcmp(&e->sprite->cache_key, b->keys + i, sizeof(scene_sprite_key_t)))
+			return false;
+	}
+	return true;
 }
 
 void scene_draw(scene_t * scene)
 {
+	PF_BEGIN("scene_draw");
 	if(scene->pass_callback)
 		scene->pass_callback(scene, SCENE_PASS_DRAW);
 
+	// viewport and parent world are known only now
+	if(scene->bake_on_draw)
+	{
+		scene->bake_on_draw = false;
+		scene_bake(scene);
+	}
+
+	scene_bake_t * b = scene->bake;
+	size_t next_run = 0;
+
 	for(size_t i = 0; i < scene->entities_count; ++i)
 	{
 		scene_entity_t * e = scene->entities[i];
 
+		if(b && next_run < b->runs_count && b->runs[next_run].first == i)
+		{
+			scene_bake_run_t * run = b->runs + next_run++;
+
+			if(_run_unchanged(scene, b, run))
+			{
+				for(size_t j = run->draw_first; j < run->draw_first + run->draw_count; ++j)
+				{
+					scene_bake_draw_t * d = b->draws + j;
+					rb_add_static(d->tex, b->vbuf, d->v, d->vc, b->ibuf, d->i, d->ic, SPRITE_STATE);
+				}
+				i += run->count - 1;
+				continue;
+			}
+			// otherwise something in it changed, so it's drawn in immediate mode this time
+		}
+
 		if(e->callback)
 			e->callback(e, scene);
 
 		if(e->visible)
 			scene_draw_entity(e);
 	}
+	PF_END();
 }
 
-void scene_draw_entity(scene_entity_t * e)
+// returns true if vertexes were rebuilt
+static bool _update_sprite(scene_entity_t * e, scene_sprite_t * c)
 {
-	if(e->sprite)
-	{
-		scene_sprite_t * c = e->sprite;
+	scene_sprite_key_t key;
+	memset(&key, 0, sizeof(key)); // padding is compared as well
+	key.parent_world = tr_get_parent_world2d();
+	key.x = e->x;
+	key.y = e->y;
+	key.r = e->r;
+	key.rox = e->rox;
+	key.roy = e->roy;
+	key.sx = e->sx;
+	key.sy = e->sy;
+	key.sox = e->sox;
+	key.soy = e->soy;
+	key.ox = e->ox;
+	key.oy = e->oy;
+	key.w = c->tex_9slice ? e->start_w * e->sx : c->tex.w * e->sx;
+	key.h = c->tex_9slice ? e->start_h * e->sy : c->tex.h * e->sy;
+	key.diffuse = c->diffuse;
+	key.tex = c->tex;
+	if(c->tex_9slice)
+		key.tex_9slice = *c->tex_9slice;
+
+	// mapping depends on viewport size, so do it before comparing
+	if(c->pixel_perfect)
+		r_pixel_perfect_map(&key.x, &key.y, key.w, key.h);
 
+	if(e->dirty || !c->cache_valid || memcmp(&key, &c->cache_key, sizeof(key)))
+	{
 		if(c->tex_9slice)
 		{
-			r_9slice(
+			r_9slice_vertices(
+				c->cache_v,
 				c->tex, *c->tex_9slice,
-				e->start_w * e->sx, e->start_h * e->sy,
-				e->x, e->y,
+				key.w, key.h,
+				key.x, key.y,
 				e->r, e->rox, e->roy,
 				e->ox, e->oy,
 				c->diffuse.r, c->diffuse.g, c->diffuse.b, c->diffuse.a,
-				c->pixel_perfect
+				false
 			);
 		}
 		else
 		{
-			r_render_sprite_ex(
+			r_sprite_vertices(
+				c->cache_v,
 				c->tex,
-				e->x, e->y,
+				key.x, key.y,
 				e->r, e->rox, e->roy,
 				e->sx, e->sy, e->sox, e->soy, e->ox, e->oy,
 				c->diffuse.r, c->diffuse.g, c->diffuse.b, c->diffuse.a,
-				c->pixel_perfect
+				false
 			);
 		}
+
+		memcpy(&c->cache_key, &key, sizeof(key));
+		c->cache_valid = true;
+		e->dirty = false;
+		return true;
 	}
 
+	return false;
+}
+
+static void _draw_sprite(scene_entity_t * e, scene_sprite_t * c)
+{
+	_update_sprite(e, c);
+
+	// hint is consumed even if culled, same as r_render_sprite_ex
+	uint64_t state = r_sprite_state();
+	if(r_culled_vertices(c->cache_v, c->tex_9slice ? 16 : 4))
+		return;
+
+	if(c->tex_9slice)
+		r_render_world(c->cache_v, 16, r_9slice_indices(), 6 * 9, c->tex.tex, state);
+	else
+		r_render_world_quads(c->cache_v, 1, c->tex.tex, state);
+}
+
+void scene_draw_entity(scene_entity_t * e)
+{
+	if(e->sprite)
+		_draw_sprite(e, e->sprite);
+
 	if(e->text)
 	{
 		scene_text_t * c = e->text;
@@ -81,6 +337,31 @@ void scene_draw_entity(scene_entity_t * e)
 	}
 }
 
+void scene_entity_set_pos(scene_entity_t * e, float x, float y)
+{
+	e->x = x;
+	e->y = y;
+	e->dirty = true;
+}
+
+void scene_entity_set_rotation(scene_entity_t * e, float r)
+{
+	e->r = r;
+	e->dirty = true;
+}
+
+void scene_entity_set_scale(scene_entity_t * e, float sx, float sy)
+{
+	e->sx = sx;
+	e->sy = sy;
+	e->dirty = true;
+}
+
+void scene_entity_dirty(scene_entity_t * e)
+{
+	e->dirty = true;
+}
+
 scene_entities_list_t scene_get_entities_for_prefix(scene_t * scene, const char * prefix)
 {
 	scene_entities_list_t r = {0};
@@ -131,7 +412,7 @@ gbRect2 sprite_AABB(scene_sprite_t * c, bool original)
 		);
 	}
 
-	trns_t model = tr_model_spr(
+	trns2d_t model = tr2d_model_spr(
 		e->x, e->y,
 		e->r, e->rox, e->roy,
 		e->sx, e->sy, e->sox, e->soy,
@@ -139,23 +420,18 @@ gbRect2 sprite_AABB(scene_sprite_t * c, bool original)
 		e->ox, e->oy
 	);
 
-	const gbVec4 sprite_vertices[4] =
+	const gbVec2 sprite_vertices[4] =
 	{
-		{-0.5f,  0.5f, 0.0f, 1.0f},
-		{ 0.5f,  0.5f, 0.0f, 1.0f},
-		{ 0.5f, -0.5f, 0.0f, 1.0f},
-		{-0.5f, -0.5f, 0.0f, 1.0f},
+		{{-0.5f,  0.5f}},
+		{{ 0.5f,  0.5f}},
+		{{ 0.5f, -0.5f}},
+		{{-0.5f, -0.5f}},
 	};
 
-	gbVec4 results[4] = {0};
-
-	for(uint8_t i = 0; i < 4; ++i)
-		gb_mat4_mul_vec4(&results[i], &model, sprite_vertices[i]);
-
 	gbRect2 ret = {0};
 	for(uint8_t i = 0; i < 4; ++i)
 	{
-		gbRect2 cur = gb_rect2(results[i].xy, gb_vec2_zero());
+		gbRect2 cur = gb_rect2(tr2d_apply(model, sprite_vertices[i]), gb_vec2_zero());
 		ret = i ? gb_rect2_union(ret, cur) : cur;
 	}
 
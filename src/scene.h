@@ -14,6 +14,7 @@ typedef struct scene_sprite_t scene_sprite_t;
 typedef struct scene_text_t scene_text_t;
 typedef struct scene_button_t scene_button_t;
 typedef struct scene_t scene_t;
+typedef struct scene_bake_t scene_bake_t;
 
 // -----------------------------------------------------------------------------
 
@@ -27,6 +28,7 @@ struct scene_entity_t
 	float start_w, start_h;								// original size
 
 	bool visible; // TODO rename to enabled
+	bool dirty; // forces cached vertexes to be rebuilt, see scene_entity_dirty
 
 	const char * name; // object name, same as in psd
 
@@ -40,6 +42,16 @@ struct scene_entity_t
 
 // -----------------------------------------------------------------------------
 
+// everything sprite vertexes depend on, if it didn't change we can reuse vertexes from previous frame
+typedef struct
+{
+	trns2d_t parent_world;
+	float x, y, r, rox, roy, sx, sy, sox, soy, ox, oy, w, h;
+	r_colorf_t diffuse;
+	tex_t tex;
+	tex_9slice_t tex_9slice;
+} scene_sprite_key_t;
+
 struct scene_sprite_t
 {
 	scene_entity_t * entity;
@@ -52,6 +64,11 @@ struct scene_sprite_t
 	tex_9slice_t * tex_9slice;
 
 	bool pixel_perfect;
+
+	// world space vertexes from the last draw, 4 for sprite, 16 for 9slice
+	bool cache_valid;
+	scene_sprite_key_t cache_key;
+	vrtx_t cache_v[16];
 };
 
 struct scene_text_t
@@ -113,12 +130,27 @@ struct scene_t
 
 	scene_pass_callback_t pass_callback;
 	uintptr_t userdata;
+
+	scene_bake_t * bake; // see scene_bake
+	bool bake_on_draw; // scene_bake is done in next scene_draw, generated loaders set it
 };
 
 void scene_free(scene_t * scene);
 void scene_draw(scene_t * scene);
 void scene_draw_entity(scene_entity_t * entity);
 
+// puts runs of visible sprites without callbacks into static gpu buffers, in world space with current parent world
+// baked runs are submitted as is while nothing in them differs from bake time, otherwise they are drawn in immediate mode
+// call after r_viewport, or set bake_on_draw, and again after big changes to rebake
+void scene_bake(scene_t * scene);
+void scene_unbake(scene_t * scene);
+
+// setters mark entity dirty, plain field writes are still picked up by comparing with cached values
+void scene_entity_set_pos(scene_entity_t * entity, float x, float y);
+void scene_entity_set_rotation(scene_entity_t * entity, float r);
+void scene_entity_set_scale(scene_entity_t * entity, float sx, float sy);
+void scene_entity_dirty(scene_entity_t * entity); // call after changing something else, e.g. 9slice params or texture contents
+
 // -----------------------------------------------------------------------------
 
 #define SCENE_MAX_ENT_SEARCH_COUNT 128
@@ -0,0 +1,11 @@
+$input v_color0, v_texcoord0
+
+#include <bgfx_shader.sh>
+
+SAMPLER2D(s_texture, 0);
+
+// glyph coverage is in red channel of single channel atlas
+void main()
+{
+	gl_FragColor = vec4(v_color0.rgb, v_color0.a * texture2D(s_texture, v_texcoord0).r);
+}
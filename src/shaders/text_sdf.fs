@@ -0,0 +1,13 @@
+$input v_color0, v_texcoord0
+
+#include <bgfx_shader.sh>
+
+SAMPLER2D(s_texture, 0);
+
+// distance is in red channel, 0.5 is the glyph edge
+void main()
+{
+	float d = texture2D(s_texture, v_texcoord0).r;
+	float w = max(fwidth(d) * 0.5, 0.001); // screen space smoothing keeps edges sharp at any scale
+	gl_FragColor = vec4(v_color0.rgb, v_color0.a * smoothstep(0.5 - w, 0.5 + w, d));
+}
@@ -17,7 +17,7 @@
 
 void _spAtlasPage_createTexture(spAtlasPage * self, const char * path)
 {
-	tex_t spr = r_load(path, TEX_FLAGS_NONE
+	tex_t spr = r_load(path, TEX_FLAGS_NO_ATLAS // attachments use page uvs directly
 			| (self->magFilter == SP_ATLAS_NEAREST ? TEX_FLAGS_POINT : 0)
 			| (self->uWrap == SP_ATLAS_REPEAT && self->vWrap == SP_ATLAS_REPEAT ? TEX_FLAGS_REPEAT : 0)
 			);
@@ -1,4 +1,5 @@
 #include "transforms.h"
+#include <stdbool.h>
 #include <stdio.h>
 #include <bgfx.h>
 
@@ -58,6 +59,71 @@ trns_t tr_model_spr(float x, float y,
 	return _tr_muls(muls, sizeof(muls) / sizeof(muls[0]));
 }
 
+trns2d_t tr2d_mul(trns2d_t a, trns2d_t b)
+{
+	trns2d_t r;
+	r.a  = a.a * b.a  + a.c * b.b;
+	r.b  = a.b * b.a  + a.d * b.b;
+	r.c  = a.a * b.c  + a.c * b.d;
+	r.d  = a.b * b.c  + a.d * b.d;
+	r.tx = a.a * b.tx + a.c * b.ty + a.tx;
+	r.ty = a.b * b.tx + a.d * b.ty + a.ty;
+	return r;
+}
+
+trns2d_t tr2d_identity()
+{
+	trns2d_t r = {{1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f}};
+	return r;
+}
+
+trns2d_t tr2d_model_spr(float x, float y,
+					float r_deg, float rox, float roy,
+					float sx, float sy, float sox, float soy,
+					float w, float h, float ox, float oy)
+{
+	// same chain as tr_model_spr, applied to origin and basis directly
+	float rad = -r_deg * GB_MATH_PI / 180.0f;
+	float cr = gb_cos(rad);
+	float sr = gb_sin(rad);
+
+	// position of (0, 0) after origin, sprite size and scale around scale origin
+	float qx = sox + sx * (-w * ox - sox) - rox;
+	float qy = soy + sy * (-h * oy - soy) - roy;
+
+	trns2d_t r;
+	r.a  =  cr * sx * w;
+	r.b  =  sr * sx * w;
+	r.c  = -sr * sy * h;
+	r.d  =  cr * sy * h;
+	r.tx = x + rox + cr * qx - sr * qy;
+	r.ty = y + roy + sr * qx + cr * qy;
+	return r;
+}
+
+trns2d_t tr2d_from_trns(trns_t tr)
+{
+	trns2d_t r = {{tr.e[0], tr.e[1], tr.e[4], tr.e[5], tr.e[12], tr.e[13]}};
+	return r;
+}
+
+trns_t tr2d_to_trns(trns2d_t tr)
+{
+	trns_t r = tr_identity();
+	r.e[0] = tr.a;
+	r.e[1] = tr.b;
+	r.e[4] = tr.c;
+	r.e[5] = tr.d;
+	r.e[12] = tr.tx;
+	r.e[13] = tr.ty;
+	return r;
+}
+
+gbVec2 tr2d_apply(trns2d_t tr, gbVec2 pos)
+{
+	return gb_vec2(tr.a * pos.x + tr.c * pos.y + tr.tx, tr.b * pos.x + tr.d * pos.y + tr.ty);
+}
+
 void tr_debug(trns_t tr)
 {
 	// m [j] [i], strange notation, I know
@@ -79,11 +145,15 @@ struct
 	trns_t view;
 	trns_t parent_world;
 	trns_t model;
+	trns2d_t parent_world2d;
+	trns2d_t model2d;
 
 	// calculated
 	trns_t viewport;
 	trns_t world;
 	trns_t vpv; // viewport * prj * view
+	trns2d_t world2d;
+	bool world_stale; // model and world should be recalculated from 2d versions
 } ctx;
 
 static trns_t _to_bgfx(trns_t t)
@@ -116,9 +186,21 @@ void tr_set_view_prj(uint8_t viewid, trns_t prj, trns_t view, gbVec2 viewport_po
 	bgfx_set_transform(_to_bgfx(tr_identity()).e, 1);
 }
 
+static void _refresh_world()
+{
+	if(!ctx.world_stale)
+		return;
+
+	ctx.model = tr2d_to_trns(ctx.model2d);
+	ctx.world = tr_mul(ctx.parent_world, ctx.model);
+	ctx.world_stale = false;
+}
+
 void tr_set_parent_world(trns_t parent_world)
 {
+	_refresh_world(); // model might be only in 2d form
 	ctx.parent_world = parent_world;
+	ctx.parent_world2d = tr2d_from_trns(parent_world);
 }
 
 trns_t tr_get_parent_world()
@@ -126,25 +208,53 @@ trns_t tr_get_parent_world()
 	return ctx.parent_world;
 }
 
+trns2d_t tr_get_parent_world2d()
+{
+	return ctx.parent_world2d;
+}
+
 void tr_set_world(trns_t model)
 {
 	ctx.model = model;
 	ctx.world = tr_mul(ctx.parent_world, ctx.model);
+	ctx.model2d = tr2d_from_trns(model);
+	ctx.world2d = tr2d_from_trns(ctx.world);
+	ctx.world_stale = false;
+}
+
+void tr_set_world2d(trns2d_t model)
+{
+	ctx.model2d = model;
+	ctx.world2d = tr2d_mul(ctx.parent_world2d, model);
+	ctx.world_stale = true;
+}
+
+trns_t tr_get_vpv()
+{
+	return ctx.vpv;
 }
 
 trns_t tr_get_model()
 {
+	_refresh_world();
 	return ctx.model;
 }
 
 trns_t tr_get_world()
 {
+	_refresh_world();
 	return ctx.world;
 }
 
+trns2d_t tr_get_world2d()
+{
+	return ctx.world2d;
+}
+
 gbVec2 tr_prj(gbVec2 pos)
 {
 	// TODO maybe add some caching here?
+	_refresh_world();
 	trns_t vpvw = tr_mul(ctx.vpv, ctx.world);
 
 	gbVec4 ret;
@@ -155,6 +265,7 @@ gbVec2 tr_prj(gbVec2 pos)
 gbVec2 tr_inverted_prj(gbVec2 pos)
 {
 	// TODO maybe add some caching here?
+	_refresh_world();
 	trns_t vpvw = tr_mul(ctx.vpv, ctx.world);
 	trns_t inv_vpvw;
 	gb_mat4_inverse(&inv_vpvw, &vpvw);
@@ -5,6 +5,15 @@
 
 typedef gbMat4 trns_t;
 
+// 2d affine transform, 2x3 column major
+// x' = a * x + c * y + tx
+// y' = b * x + d * y + ty
+typedef union
+{
+	struct {float a, b, c, d, tx, ty;};
+	float e[6];
+} trns2d_t;
+
 trns_t tr_mul(trns_t a, trns_t b); // generally look, position vector is from right here
 trns_t tr_ortho(float left, float right, float bottom, float top, float z_near, float z_far);
 trns_t tr_identity();
@@ -14,12 +23,26 @@ trns_t tr_model_spr(float x, float y,
 					float w, float h, float ox, float oy);
 void   tr_debug(trns_t tr);
 
+trns2d_t tr2d_mul(trns2d_t a, trns2d_t b); // R = A * B
+trns2d_t tr2d_identity();
+trns2d_t tr2d_model_spr(float x, float y, // same as tr_model_spr, but closed form
+					float r_deg, float rox, float roy,
+					float sx, float sy, float sox, float soy,
+					float w, float h, float ox, float oy);
+trns2d_t tr2d_from_trns(trns_t tr); // drops z and projective parts
+trns_t   tr2d_to_trns(trns2d_t tr);
+gbVec2   tr2d_apply(trns2d_t tr, gbVec2 pos);
+
 void tr_set_view_prj(uint8_t viewid, trns_t prj, trns_t view, gbVec2 viewport_pos, gbVec2 viewport_size);
 void tr_set_parent_world(trns_t parent_world);
 trns_t tr_get_parent_world();
+trns2d_t tr_get_parent_world2d();
 void tr_set_world(trns_t model);
+void tr_set_world2d(trns2d_t model); // cheaper, 4x4 world is only calculated if someone asks for it
 trns_t tr_get_model();
 trns_t tr_get_world();
+trns2d_t tr_get_world2d();
+trns_t tr_get_vpv(); // world to viewport pixels, y down, without model
 
 gbVec2 tr_prj(gbVec2 pos);
 gbVec2 tr_inverted_prj(gbVec2 pos);
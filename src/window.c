@@ -4,22 +4,132 @@
 #include "sound.h"
 #include "physics.h"
 #include "render_text.h"
+#include "render_soft.h"
+#include "profiler.h"
+#include "portable.h"
 #include <bgfxplatform.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 #endif
 
+// there is no window on linux, it's a headless build for benchmarking with noop renderer
+// frame times and render stats of the whole run are printed in entrypoint_deinit
+#if BX_PLATFORM_LINUX
+#define W_HEADLESS
+#endif
+
+// loop isn't paced by display on these, only bgfx_frame waits for vsync, so idle frames sleep instead
+#if (BX_PLATFORM_WINDOWS || BX_PLATFORM_OSX || BX_PLATFORM_ANDROID) && defined(ENTRYPOINT_PROVIDE_TIME)
+#define W_IDLE_SLEEP
+#endif
+
+#ifndef W_IDLE_FRAME_TIME
+#define W_IDLE_FRAME_TIME (1.0 / 60.0)
+#endif
+#ifndef W_MAX_STEPS
+#define W_MAX_STEPS (8) // fixed updates per frame, if we can't keep up the rest of time is dropped
+#endif
+
 static struct
 {
 	ep_size_t size;
 	uint32_t reset_flags;
+	uint32_t dbg;
+	float fixed_dt; // 0 is variable step
+	float accumulator;
+	float alpha;
+	bool on_demand;
+	bool dirty;
 	#ifdef ENTRYPOINT_PROVIDE_INPUT
 	ep_touch_t touch;
 	bool touch_hit[ENTRYPOINT_MAX_MULTITOUCH];
 	#endif
+	#ifdef W_HEADLESS
+	float * frame_ms;
+	uint32_t frame_count;
+	uint32_t frame_cap;
+	r_stats_t stats_sum;
+	r_stats_t stats_max;
+	const char * capture; // --capture file.png writes last frame of software rasteriser
+	const char * trace; // --trace file.json writes profiler zones of the last frames
+	#endif
 } ctx;
 
+#ifdef W_HEADLESS
+static void _bench_frame(double seconds)
+{
+	if(ctx.frame_count >= ctx.frame_cap)
+	{
+		ctx.frame_cap = ctx.frame_cap ? ctx.frame_cap * 2 : 1024;
+		ctx.frame_ms = (float*)realloc(ctx.frame_ms, ctx.frame_cap * sizeof(float));
+	}
+	ctx.frame_ms[ctx.frame_count++] = (float)(seconds * 1000.0);
+
+	#define SUM(field) {ctx.stats_sum.field += s->field; if(s->field > ctx.stats_max.field) ctx.stats_max.field = s->field;}
+	const r_stats_t * s = r_stats();
+	SUM(draw_calls);
+	SUM(vertices);
+	SUM(indices);
+	SUM(flushes);
+	SUM(texture_switches);
+	SUM(scissor_switches);
+	SUM(culled);
+	SUM(glyph_evictions);
+	for(uint8_t i = 0; i < R_PHASE_COUNT; ++i)
+		SUM(cpu_ms[i]);
+	#undef SUM
+}
+
+static int _cmp_float(const void * a, const void * b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static float _percentile(float p)
+{
+	uint32_t i = (uint32_t)(p * (ctx.frame_count - 1) + 0.5f);
+	return ctx.frame_ms[i];
+}
+
+static void _bench_report()
+{
+	if(!ctx.frame_count)
+		return;
+
+	uint32_t c = ctx.frame_count; // render stats are averaged over all frames
+
+	// first frames include loading and warm up of caches, so they don't count for frame times
+	uint32_t skip = ctx.frame_count > 10 ? ctx.frame_count / 10 : 0;
+	uint32_t n = ctx.frame_count - skip;
+	double total = 0.0;
+	for(uint32_t i = skip; i < ctx.frame_count; ++i)
+		total += ctx.frame_ms[i];
+	memmove(ctx.frame_ms, ctx.frame_ms + skip, n * sizeof(float));
+	ctx.frame_count = n;
+	qsort(ctx.frame_ms, n, sizeof(float), _cmp_float);
+
+	const r_stats_t * a = &ctx.stats_sum, * m = &ctx.stats_max;
+	ep_log("frames     %u (%u warm up skipped) %ux%u\n", n, skip, ctx.size.w, ctx.size.h);
+	ep_log("frame ms   mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f\n", total / n, _percentile(0.5f), _percentile(0.9f), _percentile(0.99f), ctx.frame_ms[n - 1]);
+	ep_log("cpu ms     update %.3f render %.3f flush %.3f frame %.3f (mean)\n",
+		a->cpu_ms[R_PHASE_UPDATE] / c, a->cpu_ms[R_PHASE_RENDER] / c, a->cpu_ms[R_PHASE_FLUSH] / c, a->cpu_ms[R_PHASE_FRAME] / c);
+	ep_log("draw calls mean %.1f max %u  tex switches mean %.1f max %u  scissors mean %.1f\n",
+		(double)a->draw_calls / c, m->draw_calls, (double)a->texture_switches / c, m->texture_switches, (double)a->scissor_switches / c);
+	ep_log("vertices   mean %.1f max %u  indices mean %.1f max %u  culled mean %.1f\n",
+		(double)a->vertices / c, m->vertices, (double)a->indices / c, m->indices, (double)a->culled / c);
+	ep_log("flushes    mean %.1f max %u  glyph evictions %u\n", (double)a->flushes / c, m->flushes, a->glyph_evictions);
+
+	free(ctx.frame_ms);
+	ctx.frame_ms = NULL;
+	ctx.frame_count = ctx.frame_cap = 0;
+}
+#endif
+
 #if 0
 void bgfx_fatal(bgfx_callback_interface_t* _this, bgfx_fatal_t _code, const char* _str)
 {
@@ -52,18 +162,42 @@ void bgfx_capture_frame(bgfx_callback_interface_t* _this, const void* _data, uin
 }
 #endif
 
+static int32_t _update(float dt)
+{
+	PF_BEGIN("game_update");
+	int32_t err = game_update(ctx.size.w, ctx.size.h, dt);
+	PF_END();
+	return err;
+}
+
+#ifdef ENTRYPOINT_PROVIDE_INPUT
+static bool _touch_changed(const ep_touch_t * a, const ep_touch_t * b)
+{
+	if(a->x != b->x || a->y != b->y || a->flags != b->flags)
+		return true;
+	for(size_t i = 0; i < ENTRYPOINT_MAX_MULTITOUCH; ++i)
+		if(a->multitouch[i].touched != b->multitouch[i].touched || (b->multitouch[i].touched && (a->multitouch[i].x != b->multitouch[i].x || a->multitouch[i].y != b->multitouch[i].y)))
+			return true;
+	return false;
+}
+#endif
+
 int32_t entrypoint_init(int32_t argc, char * argv[])
 {
+	_pf_init();
 	ctx.size = ep_size();
+	ctx.dirty = true;
 
-	#if defined(EMSCRIPTEN)
+	#if defined(EMSCRIPTEN) || defined(W_HEADLESS)
 	ctx.reset_flags = BGFX_RESET_NONE;
 	#else
 	ctx.reset_flags = BGFX_RESET_VSYNC;
 	#endif
 
 	bgfx_platform_data_t pd = {0};
-	#if BX_PLATFORM_LINUX || BX_PLATFORM_BSD
+	#if BX_PLATFORM_LINUX
+	// noop renderer doesn't need a window
+	#elif BX_PLATFORM_BSD
 	#error TODO
 	#elif BX_PLATFORM_IOS
 	pd.nwh					= ep_ctx()->caeagllayer;
@@ -94,20 +228,36 @@ int32_t entrypoint_init(int32_t argc, char * argv[])
 	cb_interface_ptr = &cb_interface;
 	#endif
 
+	#ifdef W_HEADLESS
+	bgfx_init(BGFX_RENDERER_TYPE_NOOP, BGFX_PCI_ID_NONE, 0, cb_interface_ptr, NULL);
+	#else
 	bgfx_init(BGFX_RENDERER_TYPE_COUNT, BGFX_PCI_ID_NONE, 0, cb_interface_ptr, NULL);
+	#endif
 
 	// enable retina in bgfx only if entrypoint is built with it
 	if(ep_retina() && (bgfx_get_caps()->supported & BGFX_CAPS_HIDPI))
 		ctx.reset_flags |= BGFX_RESET_HIDPI;
 
 	bgfx_reset(ctx.size.w, ctx.size.h, ctx.reset_flags);
+	rs_resize(ctx.size.w, ctx.size.h);
+
+	#ifdef W_HEADLESS
+	for(int32_t i = 1; i + 1 < argc; ++i)
+		if(!strcmp(argv[i], "--capture"))
+			ctx.capture = argv[i + 1];
+		else if(!strcmp(argv[i], "--trace"))
+			ctx.trace = argv[i + 1];
+	#endif
 
 	_r_init();
 	_s_init();
 //	_p_init();
 	_t_init(1024, 1024);
 
-	return game_init(argc, argv);
+	PF_BEGIN("game_init");
+	int32_t err = game_init(argc, argv);
+	PF_END();
+	return err;
 
 //	emscripten_set_main_loop(&w_loop, -1, 1);
 }
@@ -116,12 +266,21 @@ int32_t entrypoint_deinit()
 {
 	int32_t err = game_deinit();
 
+	#ifdef W_HEADLESS
+	_bench_report();
+	if(ctx.capture && !rs_write_png(ctx.capture))
+		ep_log("failed to write %s, software rasteriser needs SOFT_RASTER build\n", ctx.capture);
+	if(ctx.trace && !pf_write_trace(ctx.trace))
+		ep_log("failed to write %s, profiler needs PROFILER build\n", ctx.trace);
+	#endif
+
 	_t_deinit();
 //	_p_deinit();
 	_s_deinit();
 	_r_deinit();
 
 	bgfx_shutdown();
+	_pf_deinit();
 
 	return err;
 }
@@ -146,11 +305,14 @@ int32_t entrypoint_loop()
 		return 0;
 	#endif
 
-	// get dt
+	#if defined(W_HEADLESS) || defined(W_IDLE_SLEEP)
+	double frame_time = hp_time();
+	#endif
+	PF_BEGIN("frame");
+
+	// get dt, clamped later in variable step only, fixed step catches up itself up to W_MAX_STEPS
 	#ifdef ENTRYPOINT_PROVIDE_TIME
 	float dt = (float)ep_delta_time();
-	if(dt > 1.0f / 25.0f)
-		dt = 1.0f / 25.0f;
 	#else
 	float dt = 1.0f / 60.0f;
 	#endif
@@ -161,6 +323,8 @@ int32_t entrypoint_loop()
 	{
 		ctx.size = s;
 		bgfx_reset(ctx.size.w, ctx.size.h, ctx.reset_flags);
+		rs_resize(ctx.size.w, ctx.size.h);
+		ctx.dirty = true;
 	}
 
 	// handle touch
@@ -168,30 +332,130 @@ int32_t entrypoint_loop()
 	ep_touch_t prev_touch = ctx.touch;
 	ep_touch(&ctx.touch);
 	for(size_t i = 0; i < ENTRYPOINT_MAX_MULTITOUCH; ++i)
-		ctx.touch_hit[i] = ctx.touch.multitouch[i].touched && (!prev_touch.multitouch[i].touched);
+	{
+		bool hit = ctx.touch.multitouch[i].touched && (!prev_touch.multitouch[i].touched);
+		ctx.touch_hit[i] = hit || (ctx.fixed_dt > 0.0f && ctx.touch_hit[i]); // in fixed step hits wait for an update
+	}
+	if(_touch_changed(&prev_touch, &ctx.touch))
+		ctx.dirty = true;
 	#endif
 
 	// update
-	int32_t err1 = game_update(ctx.size.w, ctx.size.h, dt);
+	double time = hp_time();
+	int32_t err1 = 0;
+	if(ctx.fixed_dt > 0.0f)
+	{
+		ctx.accumulator += dt;
+		for(uint32_t step = 0; ctx.accumulator >= ctx.fixed_dt; ++step)
+		{
+			if(step == W_MAX_STEPS)
+			{
+				ctx.accumulator = fmodf(ctx.accumulator, ctx.fixed_dt);
+				break;
+			}
+			err1 |= _update(ctx.fixed_dt);
+			ctx.accumulator -= ctx.fixed_dt;
+			#ifdef ENTRYPOINT_PROVIDE_INPUT
+			memset(ctx.touch_hit, 0, sizeof(ctx.touch_hit));
+			#endif
+		}
+		ctx.alpha = ctx.accumulator / ctx.fixed_dt;
+	}
+	else
+	{
+		if(dt > 1.0f / 25.0f)
+			dt = 1.0f / 25.0f;
+		err1 = _update(dt);
+	}
+	PF_BEGIN("_s_update");
 	_s_update();
+	PF_END();
 	//_p_update(dt);
+	_r_stats_phase(R_PHASE_UPDATE, hp_time() - time);
 
-	// render
-	_t_cleanup();
-	int32_t err2 = game_render(ctx.size.w, ctx.size.h, dt);
-	//_p_debug_render();
-	bgfx_frame(false);
+	// render, cleared before game_render so it can keep itself dirty while animating
+	int32_t err2 = 0;
+	if(!ctx.on_demand || ctx.dirty || r_load_pending())
+	{
+		ctx.dirty = false;
+
+		time = hp_time();
+		PF_BEGIN("_t_cleanup");
+		_t_cleanup();
+		PF_END();
+		PF_BEGIN("game_render");
+		err2 = game_render(ctx.size.w, ctx.size.h, dt);
+		PF_END();
+		//_p_debug_render();
+		PF_BEGIN("_t_flush");
+		_t_flush();
+		PF_END();
+		_r_stats_phase(R_PHASE_RENDER, hp_time() - time);
+
+		if(ctx.dbg & DBG_RENDER_STATS)
+		{
+			bgfx_dbg_text_clear(0, false);
+			r_stats_hud(1, 1);
+		}
+
+		time = hp_time();
+		PF_BEGIN("rs_frame");
+		rs_frame();
+		PF_END();
+		PF_BEGIN("bgfx_frame");
+		bgfx_frame(false);
+		PF_END();
+		_r_stats_phase(R_PHASE_FRAME, hp_time() - time);
+		_r_stats_frame(); // idle frames don't roll over, so r_stats keeps the last rendered one
+	}
+	#ifdef W_IDLE_SLEEP
+	else
+	{
+		double left = W_IDLE_FRAME_TIME - (hp_time() - frame_time);
+		if(left > 0.0)
+			ep_sleep(left);
+	}
+	#endif
+	PF_END();
+
+	#ifdef W_HEADLESS
+	_bench_frame(hp_time() - frame_time);
+	#endif
 
 	return (err1 != 0 || err2 != 0) ? 1 : 0;
 }
 
+void w_fixed_step(float hz)
+{
+	ctx.fixed_dt = hz > 0.0f ? 1.0f / hz : 0.0f;
+	ctx.accumulator = ctx.fixed_dt; // so first frame after this always updates
+	ctx.alpha = 0.0f;
+}
+
+float w_alpha()
+{
+	return ctx.fixed_dt > 0.0f ? ctx.alpha : 1.0f;
+}
+
+void w_render_on_demand(bool enabled)
+{
+	ctx.on_demand = enabled;
+	ctx.dirty = true;
+}
+
+void w_dirty()
+{
+	ctx.dirty = true;
+}
+
 uint16_t w_width()	{return ctx.size.w;}
 uint16_t w_height() {return ctx.size.h;}
 
 void w_dbg(uint32_t options)
 {
+	ctx.dbg = options;
 	bgfx_set_debug(BGFX_DEBUG_NONE
-				| (options & DBG_TEXT		? BGFX_DEBUG_TEXT		: 0)
+				| (options & (DBG_TEXT | DBG_RENDER_STATS) ? BGFX_DEBUG_TEXT : 0)
 				| (options & DBG_WIREFRAME	? BGFX_DEBUG_WIREFRAME	: 0)
 				| (options & DBG_STATS		? BGFX_DEBUG_STATS		: 0)
 	);
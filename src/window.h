@@ -22,8 +22,20 @@ uint16_t w_height();
 #define DBG_TEXT		0x1
 #define DBG_WIREFRAME	0x2
 #define DBG_STATS		0x4
+#define DBG_RENDER_STATS	0x8 // r_stats overlay, implies DBG_TEXT
 void w_dbg(uint32_t options);
 
+// fixed timestep, game_update gets dt = 1 / hz as many times as time has passed, game_render stays once per frame
+// render between previous and current state with w_alpha, e.g. lerp(prev_x, x, w_alpha())
+// touch hits wait for the next update, so none are lost or seen twice, 0 hz is variable step (default)
+void w_fixed_step(float hz);
+float w_alpha(); // [0, 1) how far we are from last update to the next one, 1 in variable step
+
+// if enabled, game_render is only called after w_dirty, touch input, resize or while async loads are pending
+// game_update still runs every frame, idle frames skip bgfx_frame and sleep instead to save battery
+void w_render_on_demand(bool enabled);
+void w_dirty(); // something visible changed, render next frame
+
 // mouse
 float w_mx();
 float w_my();
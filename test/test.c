@@ -0,0 +1,449 @@
+// regression checks, built as leengine_test in headless linux build with software rasteriser
+// everything runs in game_init, exit code is number of failed cases, ctest runs them from test dir
+//
+// usage: leengine_test [--filter substring] [--out dir] [--update] --size 128x128
+// - golden cases draw one frame and compare rs_pixels against golden/<name>.png
+//   on mismatch the frame is written to <out>/<name>_actual.png, --update rewrites goldens instead
+// - golden/sorted draws the same interleaved sprites and text with rb_sorting off and on, both match one golden
+//   and sorting has to need fewer draw calls
+// - text uses res/Lato-Regular.ttf (SIL Open Font License 1.1, see res/readme.md)
+// - transforms compares closed form 2d transforms with 4x4 ones over random sprite params and parent worlds
+// - modulate compares rv_modulate (simd where available) with scalar 8.8 and float color math, tints up to 3
+
+#include "window.h"
+#include "render.h"
+#include "render_9slice.h"
+#include "render_text.h"
+#include "render_vertex.h"
+#include "render_batch.h"
+#include "render_soft.h"
+#include "filesystem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TEST_GOLDEN_TOLERANCE
+#define TEST_GOLDEN_TOLERANCE (2) // per channel, rounding of filtering and blending might differ between compilers
+#endif
+#ifndef TEST_GOLDEN_MAX_BAD
+#define TEST_GOLDEN_MAX_BAD (16) // pixels over tolerance
+#endif
+#ifndef TEST_TRANSFORM_ITERATIONS
+#define TEST_TRANSFORM_ITERATIONS (100000)
+#endif
+#ifndef TEST_TRANSFORM_TOLERANCE
+#define TEST_TRANSFORM_TOLERANCE (1e-5f) // relative to biggest element of expected matrix
+#endif
+#ifndef TEST_MODULATE_ITERATIONS
+#define TEST_MODULATE_ITERATIONS (10000)
+#endif
+#define TEST_MODULATE_COUNT 7 // not a multiple of simd width, so tails run too
+#define TEST_PNG "test_tmp.png"
+#define TEST_PNG_SIZE 32
+#define TEST_FONT "res/Lato-Regular.ttf"
+
+typedef struct
+{
+	const char * name;
+	const char * (*run)(); // returns reason of failure or NULL
+} test_case_t;
+
+static struct
+{
+	const char * filter;
+	const char * out_dir;
+	bool update;
+
+	bool tex_ready;
+	tex_t tex;
+	bool font_ready;
+	font_t font;
+
+	uint32_t seed;
+	char reason[256];
+} ctx;
+
+// -----------------------------------------------------------------------------
+// harness
+
+static void _frame()
+{
+	r_frame_end();
+	_t_flush();
+	rs_frame();
+	bgfx_frame(false);
+	_r_stats_frame();
+	_t_cleanup();
+	r_viewport(0, 0, w_width(), w_height(), r_coloru(32, 32, 48, 255));
+	tr_set_world2d(tr2d_identity());
+}
+
+// shared by golden cases, done once
+static const char * _assets_setup()
+{
+	if(!ctx.tex_ready)
+	{
+		// gradient with checker, so filtering, uv flips and slice borders all show up
+		uint32_t pixels[TEST_PNG_SIZE * TEST_PNG_SIZE];
+		for(uint32_t y = 0; y < TEST_PNG_SIZE; ++y)
+			for(uint32_t x = 0; x < TEST_PNG_SIZE; ++x)
+			{
+				uint32_t r = x * 255 / (TEST_PNG_SIZE - 1), g = y * 255 / (TEST_PNG_SIZE - 1), b = ((x / 4) ^ (y / 4)) & 1 ? 255 : 64;
+				uint32_t a = x < 2 || y < 2 ? 128 : 255;
+				pixels[y * TEST_PNG_SIZE + x] = r | (g << 8) | (b << 16) | (a << 24);
+			}
+		bool ok = stbi_write_png_fs(TEST_PNG, TEST_PNG_SIZE, TEST_PNG_SIZE, 4, pixels, TEST_PNG_SIZE * 4) != 0;
+		if(!ok)
+			return "can't write " TEST_PNG;
+
+		ctx.tex = r_load(TEST_PNG, TEX_FLAGS_NONE);
+		remove(TEST_PNG);
+		ctx.tex_ready = true;
+	}
+
+	if(!ctx.font_ready)
+	{
+		ctx.font = t_add("lato", TEST_FONT);
+		if(ctx.font < 0)
+			return "can't load " TEST_FONT ", run from test dir";
+		ctx.font_ready = true;
+	}
+	return NULL;
+}
+
+static const char * _golden(const char * name, void (*draw)())
+{
+	const char * err = _assets_setup();
+	if(err)
+		return err;
+
+	_frame();
+	draw();
+	_frame();
+
+	uint16_t w = 0, h = 0;
+	const uint8_t * pixels = rs_pixels(&w, &h);
+	if(!pixels)
+		return "no software rasteriser, build with R_SOFT";
+
+	char filename[256];
+	snprintf(filename, sizeof(filename), "golden/%s.png", name);
+	if(ctx.update)
+	{
+		if(!rs_write_png(filename))
+			return "can't write golden";
+		ep_log("updated %s\n", filename);
+		return NULL;
+	}
+
+	int gw = 0, gh = 0, comp = 0;
+	uint8_t * golden = stbi_fsload(filename, &gw, &gh, &comp, 4);
+	if(!golden)
+		return "can't load golden, run from test dir";
+
+	uint32_t bad = 0, worst = 0;
+	if(gw == w && gh == h)
+	{
+		for(uint32_t i = 0; i < (uint32_t)w * h; ++i)
+		{
+			uint32_t diff = 0;
+			for(uint32_t c = 0; c < 4; ++c)
+				diff = gb_max(diff, (uint32_t)abs((int32_t)pixels[i * 4 + c] - (int32_t)golden[i * 4 + c]));
+			worst = gb_max(worst, diff);
+			if(diff > TEST_GOLDEN_TOLERANCE)
+				bad++;
+		}
+	}
+	free(golden);
+
+	if(gw != w || gh != h)
+		snprintf(ctx.reason, sizeof(ctx.reason), "golden is %ix%i, frame is %ux%u, pass --size", gw, gh, w, h);
+	else if(bad > TEST_GOLDEN_MAX_BAD)
+		snprintf(ctx.reason, sizeof(ctx.reason), "%u pixels differ, max channel difference %u", bad, worst);
+	else
+		return NULL;
+
+	snprintf(filename, sizeof(filename), "%s/%s_actual.png", ctx.out_dir, name);
+	rs_write_png(filename);
+	return ctx.reason;
+}
+
+// -----------------------------------------------------------------------------
+// golden images
+
+static void _draw_sprite()
+{
+	r_render_sprite_ex(ctx.tex, -24.0f, 16.0f, 30.0f, 0.5f, 0.5f, 2.0f, 1.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, false);
+	r_render_sprite_ex(ctx.tex, 32.0f, -32.0f, 0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f, 1.0f, 0.25f, 0.0f, 1.0f, 0.5f, 0.5f, 0.75f, true);
+}
+static const char * _sprite() {return _golden("sprite", _draw_sprite);}
+
+static void _draw_9slice()
+{
+	tex_9slice_t slice = {0.25f, 0.25f, 0.75f, 0.75f, 1.0f};
+	r_9slice(ctx.tex, slice, 100.0f, 60.0f, 0.0f, 20.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, true);
+	r_9slice(ctx.tex, slice, 40.0f, 40.0f, -30.0f, -35.0f, 15.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.5f, 1.0f, 0.5f, 1.0f, false);
+}
+static const char * _9slice() {return _golden("9slice", _draw_9slice);}
+
+static void _draw_text()
+{
+	r_text_ex2(ctx.font, 0.0f, 20.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+		1.0f, 1.0f, 1.0f, 1.0f, false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+		NULL, TEXT_ALIGN_CENTER | TEXT_ALIGN_BASELINE, 20.0f, 0.0f, "Golden 123");
+	r_text_ex2(ctx.font, -56.0f, -24.0f, 10.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+		1.0f, 0.8f, 0.2f, 1.0f, true, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.5f,
+		NULL, TEXT_ALIGN_LEFT | TEXT_ALIGN_MIDDLE, 12.0f, 1.0f, "shadow, Wy");
+}
+static const char * _text() {return _golden("text", _draw_text);}
+
+static void _draw_sorted()
+{
+	// rows of sprite and label, nothing overlaps so sorting can merge all sprites and all labels
+	for(uint32_t i = 0; i < 4; ++i)
+	{
+		float y = 42.0f - (float)i * 28.0f;
+		char label[16];
+		snprintf(label, sizeof(label), "row %u", i);
+		r_render_sprite_ex(ctx.tex, -40.0f, y, 0.0f, 0.5f, 0.5f, 0.75f, 0.75f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, false);
+		r_text_ex2(ctx.font, -16.0f, y, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+			1.0f, 1.0f, 1.0f, 1.0f, false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+			NULL, TEXT_ALIGN_LEFT | TEXT_ALIGN_MIDDLE, 14.0f, 0.0f, label);
+	}
+}
+static const char * _sorted()
+{
+	const char * err = _golden("sorted", _draw_sorted);
+	uint32_t unsorted = r_stats()->draw_calls;
+	if(err)
+		return err;
+
+	rb_sorting(true);
+	err = _golden("sorted", _draw_sorted);
+	uint32_t sorted = r_stats()->draw_calls;
+	rb_sorting(false);
+	if(err)
+		return err;
+
+	if(sorted >= unsorted)
+	{
+		snprintf(ctx.reason, sizeof(ctx.reason), "sorting needs %u draw calls, %u without it", sorted, unsorted);
+		return ctx.reason;
+	}
+	return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// transforms
+
+static float _rand(float min, float max)
+{
+	ctx.seed = ctx.seed * 1664525u + 1013904223u;
+	return min + (max - min) * (float)(ctx.seed >> 8) / (float)(1 << 24);
+}
+
+typedef struct
+{
+	float x, y, r, rox, roy, sx, sy, sox, soy, w, h, ox, oy;
+} test_spr_t;
+
+static test_spr_t _rand_spr()
+{
+	test_spr_t p;
+	p.x = _rand(-1000.0f, 1000.0f);
+	p.y = _rand(-1000.0f, 1000.0f);
+	p.r = _rand(-720.0f, 720.0f);
+	p.rox = _rand(-1.0f, 2.0f);
+	p.roy = _rand(-1.0f, 2.0f);
+	p.sx = _rand(-4.0f, 4.0f);
+	p.sy = _rand(-4.0f, 4.0f);
+	p.sox = _rand(-1.0f, 2.0f);
+	p.soy = _rand(-1.0f, 2.0f);
+	p.w = _rand(0.0f, 512.0f);
+	p.h = _rand(0.0f, 512.0f);
+	p.ox = _rand(-1.0f, 2.0f);
+	p.oy = _rand(-1.0f, 2.0f);
+	return p;
+}
+
+static trns_t _model(test_spr_t p) {return tr_model_spr(p.x, p.y, p.r, p.rox, p.roy, p.sx, p.sy, p.sox, p.soy, p.w, p.h, p.ox, p.oy);}
+static trns2d_t _model2d(test_spr_t p) {return tr2d_model_spr(p.x, p.y, p.r, p.rox, p.roy, p.sx, p.sy, p.sox, p.soy, p.w, p.h, p.ox, p.oy);}
+
+// max difference relative to biggest element of expected
+static float _diff2d(trns2d_t actual, trns2d_t expected)
+{
+	float diff = 0.0f, size = 1.0f;
+	for(uint32_t i = 0; i < 6; ++i)
+	{
+		diff = gb_max(diff, gb_abs(actual.e[i] - expected.e[i]));
+		size = gb_max(size, gb_abs(expected.e[i]));
+	}
+	return diff / size;
+}
+
+static const char * _transforms()
+{
+	const char * what[3] = {"tr2d_model_spr", "tr_set_world2d + tr_get_world2d", "tr_set_world2d + tr_get_world"};
+	float worst[3] = {0};
+	uint32_t worst_i[3] = {0};
+
+	ctx.seed = 0x1234567u;
+	for(uint32_t i = 0; i < TEST_TRANSFORM_ITERATIONS; ++i)
+	{
+		test_spr_t p = _rand_spr();
+		trns_t parent = _model(_rand_spr());
+		trns_t model = _model(p);
+		trns2d_t expected = tr2d_from_trns(tr_mul(parent, model));
+
+		tr_set_parent_world(parent);
+		tr_set_world2d(_model2d(p));
+
+		float diff[3] =
+		{
+			_diff2d(_model2d(p), tr2d_from_trns(model)),
+			_diff2d(tr_get_world2d(), expected),
+			_diff2d(tr2d_from_trns(tr_get_world()), expected),
+		};
+		for(uint32_t j = 0; j < 3; ++j)
+			if(!(diff[j] <= worst[j])) // nan fails too
+			{
+				worst[j] = diff[j];
+				worst_i[j] = i;
+			}
+	}
+
+	tr_set_parent_world(tr_identity());
+	tr_set_world2d(tr2d_identity());
+
+	for(uint32_t j = 0; j < 3; ++j)
+		if(!(worst[j] <= TEST_TRANSFORM_TOLERANCE))
+		{
+			snprintf(ctx.reason, sizeof(ctx.reason), "%s differs by %g (relative) at iteration %u", what[j], worst[j], worst_i[j]);
+			return ctx.reason;
+		}
+	return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// modulate
+
+static uint16_t _factor(float f)
+{
+	return (uint16_t)(gb_clamp(f, 0.0f, 127.0f) * 256.0f + 0.5f);
+}
+
+// same math as rv_modulate, one channel at a time
+static r_color_t _modulate_ref(r_color_t c, r_colorf_t tint)
+{
+	const float f[4] = {tint.r, tint.g, tint.b, tint.a};
+	r_color_t r = 0;
+	for(uint32_t i = 0; i < 4; ++i)
+		r |= (r_color_t)gb_min((((c >> (i * 8)) & 0xff) * _factor(f[i])) >> 8, 0xff) << (i * 8);
+	return r;
+}
+
+static int32_t _channel_diff(r_color_t a, r_color_t b)
+{
+	int32_t diff = 0;
+	for(uint32_t i = 0; i < 32; i += 8)
+		diff = gb_max(diff, gb_abs((int32_t)((a >> i) & 0xff) - (int32_t)((b >> i) & 0xff)));
+	return diff;
+}
+
+static const char * _modulate()
+{
+	ctx.seed = 0x7654321u;
+	for(uint32_t i = 0; i < TEST_MODULATE_ITERATIONS; ++i)
+	{
+		// every 4th tint stays in [0, 1], others go up to 3 like hit flashes
+		float max = i % 4 ? 3.0f : 1.0f;
+		r_colorf_t tint = r_colorf(_rand(0.0f, max), _rand(0.0f, max), _rand(0.0f, max), _rand(0.0f, max));
+		if(i == 0)
+			tint = r_colorf(1.0f, 1.0f, 1.0f, 1.0f);
+
+		vrtx_t vbuf[TEST_MODULATE_COUNT] = {0};
+		r_color_t src[TEST_MODULATE_COUNT];
+		for(uint32_t j = 0; j < TEST_MODULATE_COUNT; ++j)
+			src[j] = vbuf[j].color = (r_color_t)(_rand(0.0f, 1.0f) * 4294967295.0f);
+		rv_modulate(vbuf, TEST_MODULATE_COUNT, tint);
+
+		for(uint32_t j = 0; j < TEST_MODULATE_COUNT; ++j)
+		{
+			r_color_t scalar = _modulate_ref(src[j], tint);
+			r_color_t flt = r_colorf_to_color(r_colorf_mul(r_color_to_colorf(src[j]), tint));
+			if(vbuf[j].color != scalar)
+				snprintf(ctx.reason, sizeof(ctx.reason), "rv_modulate %08x by (%g %g %g %g) is %08x, scalar is %08x", src[j], tint.r, tint.g, tint.b, tint.a, vbuf[j].color, scalar);
+			else if(_channel_diff(vbuf[j].color, flt) > 1)
+				snprintf(ctx.reason, sizeof(ctx.reason), "rv_modulate %08x by (%g %g %g %g) is %08x, float is %08x", src[j], tint.r, tint.g, tint.b, tint.a, vbuf[j].color, flt);
+			else if(i == 0 && vbuf[j].color != src[j])
+				snprintf(ctx.reason, sizeof(ctx.reason), "rv_modulate %08x by 1 is %08x", src[j], vbuf[j].color);
+			else
+				continue;
+			return ctx.reason;
+		}
+	}
+	return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+static const test_case_t cases[] =
+{
+	{"golden/sprite", _sprite},
+	{"golden/9slice", _9slice},
+	{"golden/text", _text},
+	{"golden/sorted", _sorted},
+	{"transforms", _transforms},
+	{"modulate", _modulate},
+};
+
+int32_t game_init(int32_t argc, char * argv[])
+{
+	ctx.out_dir = ".";
+	for(int32_t i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "--update"))
+			ctx.update = true;
+		else if(i + 1 < argc && !strcmp(argv[i], "--filter"))
+			ctx.filter = argv[++i];
+		else if(i + 1 < argc && !strcmp(argv[i], "--out"))
+			ctx.out_dir = argv[++i];
+	}
+
+	_frame();
+	int32_t failed = 0;
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		if(ctx.filter && !strstr(cases[i].name, ctx.filter))
+			continue;
+
+		const char * err = cases[i].run();
+		ep_log("%s %s%s%s\n", err ? "FAIL" : "ok  ", cases[i].name, err ? ": " : "", err ? err : "");
+		if(err)
+			failed++;
+	}
+
+	if(ctx.tex_ready)
+		r_free(ctx.tex);
+	return failed;
+}
+
+int32_t game_deinit()
+{
+	return 0;
+}
+
+int32_t game_might_unload()
+{
+	return 0;
+}
+
+int32_t game_update(uint16_t w, uint16_t h, float dt)
+{
+	return 1; // everything is done in game_init
+}
+
+int32_t game_render(uint16_t w, uint16_t h, float dt)
+{
+	return 0;
+}
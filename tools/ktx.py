@@ -0,0 +1,72 @@
+import os, sys, argparse, platform, subprocess
+
+# converts png images to gpu compressed ktx with mipmaps next to them
+# r_load picks up sibling .ktx automatically and falls back to png if it's missing
+
+root = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+formats = {
+	"android":	"ETC2A",
+	"ios":		"ASTC4x4",
+	"osx":		"BC3",
+	"windows":	"BC3",
+	"asm.js":	"RGBA8", # webgl doesn't guarantee any compressed format
+	"linux":	"RGBA8", # headless, software rasteriser only decodes uncompressed ktx
+}
+
+def texturec_path():
+	if platform.system() == "Darwin":
+		return os.path.join(root, "3rdparty", "bgfx", "bin", "texturec_osx")
+	elif platform.system() == "Linux":
+		return os.path.join(root, "3rdparty", "bgfx", "bin", "texturec_linux")
+	else:
+		return os.path.join(root, "3rdparty", "bgfx", "bin", "texturec_win.exe")
+
+def convert_folder(folder, fmt, mips = True, quality = "default", force = False, texturec = None):
+	texturec = texturec or texturec_path()
+	converted = 0
+
+	for dirpath, dirnames, filenames in os.walk(folder):
+		for filename in filenames:
+			if not filename.lower().endswith(".png"):
+				continue
+
+			src = os.path.join(dirpath, filename)
+			dst = os.path.splitext(src)[0] + ".ktx"
+
+			# skip up to date ones
+			if not force and os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+				continue
+
+			args = [texturec, "-f", src, "-o", dst, "-t", fmt, "-q", quality]
+			if mips:
+				args.append("-m")
+
+			if subprocess.call(args) != 0:
+				print("failed to convert %s" % src)
+				if os.path.exists(dst):
+					os.remove(dst)
+				continue
+
+			converted += 1
+
+	return converted
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description = "Convert images to compressed ktx")
+	parser.add_argument("-i", "--imgs",		required = True, help = "directory with images, usually the same as --imgs for slice.py")
+	parser.add_argument("-p", "--platform",	default = None, choices = sorted(formats.keys()), help = "pick texture format for platform")
+	parser.add_argument("-f", "--format",	default = None, help = "texturec format, e.g. ETC2A, ASTC4x4, BC3, overrides --platform")
+	parser.add_argument("-q", "--quality",	default = "default", choices = ["default", "fastest", "highest"], help = "encoding quality")
+	parser.add_argument("--no-mips",		default = False, action = "store_true", help = "don't generate mipmaps")
+	parser.add_argument("--force",			default = False, action = "store_true", help = "convert even if ktx is up to date")
+	parser.add_argument("--texturec",		default = None, help = "path to texturec")
+	args = vars(parser.parse_args())
+
+	fmt = args.get("format") or formats.get(args.get("platform"))
+	if not fmt:
+		print("please provide --format or --platform")
+		sys.exit(1)
+
+	count = convert_folder(args.get("imgs"), fmt, not args.get("no_mips"), args.get("quality"), args.get("force"), args.get("texturec"))
+	print("converted %u images to %s" % (count, fmt))
@@ -0,0 +1,92 @@
+import os, sys, struct, argparse
+
+# packs files into one archive which is mounted with fsmount
+# header | index sorted by hash | entries aligned to 16 bytes, see src/filesystem_pak.c
+# on android keep it uncompressed in apk (aaptOptions noCompress "pak"), so it is mapped instead of copied to heap
+
+MAGIC = b"LEPK"
+VERSION = 1
+ALIGN = 16
+HEADER = "<4sIII"
+ENTRY = "<QQII"
+
+def fnv1a64(data):
+	h = 0xcbf29ce484222325
+	for b in bytearray(data):
+		h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+	return h
+
+def gather(inputs, base):
+	files = []
+	for path in inputs:
+		if os.path.isfile(path):
+			files.append(path)
+		else:
+			for dirpath, dirnames, filenames in os.walk(path):
+				dirnames.sort()
+				for filename in sorted(filenames):
+					files.append(os.path.join(dirpath, filename))
+
+	result = []
+	for path in files:
+		name = os.path.relpath(path, base).replace(os.sep, "/")
+		result.append((name, path))
+	return result
+
+def pack(output, inputs, base, compress = False, min_ratio = 0.9, skip_ext = ()):
+	if compress:
+		import lz4.block
+
+	entries = []
+	hashes = {}
+	for name, path in gather(inputs, base):
+		if os.path.splitext(name)[1].lower() in skip_ext:
+			continue
+
+		h = fnv1a64(name.encode("utf-8"))
+		if h in hashes:
+			raise ValueError("hash collision between %s and %s" % (name, hashes[h]))
+		hashes[h] = name
+
+		with open(path, "rb") as f:
+			data = f.read()
+
+		stored = data
+		if compress and len(data):
+			packed = lz4.block.compress(data, store_size = False)
+			if len(packed) < len(data) * min_ratio: # already compressed files like png are stored as is
+				stored = packed
+
+		entries.append((h, name, len(data), stored))
+
+	entries.sort(key = lambda e: e[0])
+
+	offset = struct.calcsize(HEADER) + struct.calcsize(ENTRY) * len(entries)
+	index = []
+	for h, name, size, stored in entries:
+		offset = (offset + ALIGN - 1) // ALIGN * ALIGN
+		index.append(struct.pack(ENTRY, h, offset, size, len(stored)))
+		offset += len(stored)
+
+	with open(output, "wb") as f:
+		f.write(struct.pack(HEADER, MAGIC, VERSION, len(entries), 0))
+		for i in index:
+			f.write(i)
+		for h, name, size, stored in entries:
+			f.write(b"\0" * ((ALIGN - f.tell() % ALIGN) % ALIGN))
+			f.write(stored)
+
+	return entries
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description = "Pack files into one archive")
+	parser.add_argument("-o", "--output",	required = True, help = "output archive")
+	parser.add_argument("-b", "--base",		default = ".", help = "paths in archive are relative to this directory, so fsopen(\"res/a.png\") needs base to be parent of res")
+	parser.add_argument("-c", "--compress",	default = False, action = "store_true", help = "lz4 compress entries which get smaller")
+	parser.add_argument("--skip",			action = "append", default = [], help = "skip files with extension, e.g. --skip .psd")
+	parser.add_argument("inputs",			nargs = "+", help = "files or directories")
+	args = vars(parser.parse_args())
+
+	entries = pack(args.get("output"), args.get("inputs"), args.get("base"), args.get("compress"), skip_ext = tuple(e.lower() for e in args.get("skip")))
+	compressed = sum(1 for e in entries if len(e[3]) != e[2])
+	print("packed %u files, %u compressed, %u bytes" % (len(entries), compressed, os.path.getsize(args.get("output"))))
@@ -123,8 +123,9 @@ void {{prefix}}_load({{prefix}}_impl_t * s, scene_load_font_t load_font)
 	for(size_t i = 0; i < {{count}}; ++i)
 	{
 		assert(tex_ip[i].i == i);
-		*(s->textures[i]) = r_load(tex_ip[i].path, TEX_FLAGS_POINT);
+		r_load_async(tex_ip[i].path, TEX_FLAGS_POINT, s->textures[i]);
 	}
+	r_load_wait(); // sprites below copy textures, so they must be resolved, but images are still decoded in parallel
 	{{/textures}}
 
 
@@ -174,12 +175,9 @@ void {{prefix}}_load({{prefix}}_impl_t * s, scene_load_font_t load_font)
 		scene_sprite_t * spr = s->sprites[i];
 		assert(spr_ip[i].i == i);
 		spr->diffuse	= r_colorf(1.0f, 1.0f, 1.0f, 1.0f);
+		spr->tex		= r_sub_tex(spr->tex, spr_ip[i].u1, spr_ip[i].v1, spr_ip[i].u2, spr_ip[i].v2);
 		spr->tex.w		= spr_ip[i].w;
 		spr->tex.h		= spr_ip[i].h;
-		spr->tex.u1		= spr_ip[i].u1;
-		spr->tex.v1		= spr_ip[i].v1;
-		spr->tex.u2		= spr_ip[i].u2;
-		spr->tex.v2		= spr_ip[i].v2;
 	}
 	{{/sprites}}
 
@@ -209,6 +207,8 @@ void {{prefix}}_load({{prefix}}_impl_t * s, scene_load_font_t load_font)
 	s->texts[{{index}}]->entity = &s->{{entity_name}};
 	{{/items}}
 	{{/texts}}
+
+	s->scene.bake_on_draw = true; // static sprites are baked in first scene_draw, after r_viewport
 }
 
 """
@@ -781,6 +781,7 @@ parser.add_argument("-t", "--scale", default = 1.0, type = float, help = "scale
 parser.add_argument("-z", "--scene-scale", default = 1.0, type = float, help = "scale factor for the scene")
 parser.add_argument("--ignore", action = "append", default = [], help = "ignore layer with name")
 parser.add_argument("--cache", default = False, type = bool, help = "use caching to ignore duplicates")
+parser.add_argument("-k", "--ktx", default = None, help = "also convert images to compressed ktx, texturec format or platform name, see ktx.py")
 args = vars(parser.parse_args())
 
 Slicer(
@@ -796,3 +797,8 @@ Slicer(
 	images_path_from_source	= args.get("rel"),
 	atlas					= args.get("atlas")
 )
+
+if args.get("ktx"):
+	import ktx
+	ktx_format = ktx.formats.get(args.get("ktx"), args.get("ktx"))
+	ktx.convert_folder(args.get("imgs"), ktx_format)